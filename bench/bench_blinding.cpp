@@ -0,0 +1,51 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include "rsa.h"
+
+using namespace std;
+using namespace simple_rsa;
+
+// usage: bench_blinding [bits] [rounds]
+int main(int argc, char *argv[]) {
+  const int bits = argc > 1 ? atoi(argv[1]) : 1024;
+  const int rounds = argc > 2 ? atoi(argv[2]) : 50;
+  rsa r;
+  r.keygen(bits);
+  const rsa_context& ctx = *r.context();
+  const BigUint& n = r.key().n;
+  vector<BigUint> cs(rounds);
+  for (auto& c : cs) {
+    c.random_bits(bits - 1);
+  }
+
+  auto start = chrono::steady_clock::now();
+  for (auto& c : cs) {
+    ctx.private_op(c);
+  }
+  const double plain = chrono::duration<double>(chrono::steady_clock::now() - start).count() / rounds;
+
+  // a fresh r, r^e and r^(-1) for every operation
+  start = chrono::steady_clock::now();
+  for (auto& c : cs) {
+    BigUint x, vf;
+    do {
+      x.random_bits(bits - 1);
+      vf = n.mod_mul_inv(x);
+    } while (vf == 0);
+    BigUint vi = ctx.public_op(x);
+    ctx.private_op(c * vi % n) * vf % n;
+  }
+  const double fresh = chrono::duration<double>(chrono::steady_clock::now() - start).count() / rounds;
+
+  start = chrono::steady_clock::now();
+  for (auto& c : cs) {
+    ctx.blinded_private_op(c);
+  }
+  const double amortized = chrono::duration<double>(chrono::steady_clock::now() - start).count() / rounds;
+
+  cout<<bits<<" bits private operation"<<endl;
+  cout<<"  no blinding:        "<<plain * 1e3<<" ms"<<endl;
+  cout<<"  fresh blinding:     "<<fresh * 1e3<<" ms, +"<<(fresh / plain - 1) * 100<<"%"<<endl;
+  cout<<"  amortized blinding: "<<amortized * 1e3<<" ms, +"<<(amortized / plain - 1) * 100<<"%"<<endl;
+}
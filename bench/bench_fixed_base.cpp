@@ -0,0 +1,43 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include "fixed_base.h"
+
+using namespace std;
+using namespace simple_rsa;
+
+// usage: bench_fixed_base [bits] [rounds]
+int main(int argc, char *argv[]) {
+  const int bits = argc > 1 ? atoi(argv[1]) : 1024;
+  const int rounds = argc > 2 ? atoi(argv[2]) : 20;
+  BigUint n, g;
+  n.random_bits(bits);
+  n.set_bit(0);
+  g.random_bits(bits - 1);
+  Montgomery mont(n);
+  vector<BigUint> es(rounds);
+  for (auto& e : es) {
+    e.random_bits(bits);
+  }
+
+  auto start = chrono::steady_clock::now();
+  for (auto& e : es) {
+    mont.pow(g, e);
+  }
+  const double plain = chrono::duration<double>(chrono::steady_clock::now() - start).count() / rounds;
+  cout<<bits<<" bits, Montgomery::pow: "<<plain * 1e3<<" ms"<<endl;
+
+  const int params[][2] = {{2, 1}, {4, 1}, {4, 2}, {6, 1}, {6, 2}, {8, 2}};
+  for (auto& hv : params) {
+    start = chrono::steady_clock::now();
+    FixedBase fb(mont, g, bits, hv[0], hv[1]);
+    const double setup = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    start = chrono::steady_clock::now();
+    for (auto& e : es) {
+      fb.pow(e);
+    }
+    const double comb = chrono::duration<double>(chrono::steady_clock::now() - start).count() / rounds;
+    cout<<"h = "<<hv[0]<<", v = "<<hv[1]<<", "<<fb.table_size()<<" powers: "
+        <<comb * 1e3<<" ms, "<<plain / comb<<"x, setup "<<setup * 1e3<<" ms"<<endl;
+  }
+}
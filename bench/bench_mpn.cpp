@@ -0,0 +1,53 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "drbg.h"
+#include "montgomery.h"
+#include "mpn.h"
+
+using namespace std;
+using namespace simple_rsa;
+
+// usage: bench_mpn [rounds]
+int main(int argc, char *argv[]) {
+  const int rounds = argc > 1 ? atoi(argv[1]) : 100000;
+  const struct { mpn::kernel_set k; const char *name; } sets[] = {
+    {mpn::KERNELS_GENERIC, "generic"}, {mpn::KERNELS_ADX, "adx"}};
+  // odd sizes take the uint32 path of mont_mul
+  const size_t sizes[] = {16, 17, 32, 64};
+  for (auto& s : sets) {
+    if (!mpn::use_kernels(s.k)) {
+      cout<<s.name<<": not supported"<<endl;
+      continue;
+    }
+    for (size_t n : sizes) {
+      vector<uint32_t> a(n), b(n), r(2 * n), t(2 * n + 2);
+      Drbg::local().fill(a.data(), n);
+      Drbg::local().fill(b.data(), n);
+      auto start = chrono::steady_clock::now();
+      for (int i = 0; i < rounds; ++i) {
+        mpn::addmul_1(r.data(), a.data(), n, b[i % n]);
+      }
+      const double addmul = chrono::duration<double>(chrono::steady_clock::now() - start).count() / rounds;
+      start = chrono::steady_clock::now();
+      for (int i = 0; i < rounds / 10; ++i) {
+        mpn::mul(r.data(), a.data(), n, b.data(), n);
+      }
+      const double mul = chrono::duration<double>(chrono::steady_clock::now() - start).count() / (rounds / 10);
+
+      BigUint m(a.data(), n);
+      m.set_bit(32 * n - 1);
+      m.set_bit(0);
+      const Montgomery mont(m);
+      b.back() = 0;
+      start = chrono::steady_clock::now();
+      for (int i = 0; i < rounds / 10; ++i) {
+        mont.mul(b.data(), b.data(), a.data());
+      }
+      const double mont_mul = chrono::duration<double>(chrono::steady_clock::now() - start).count() / (rounds / 10);
+      cout<<s.name<<", "<<n * 32<<" bits: addmul_1 "<<addmul * 1e9<<" ns, mul "
+          <<mul * 1e9<<" ns, mont_mul "<<mont_mul * 1e9<<" ns"<<endl;
+    }
+  }
+}
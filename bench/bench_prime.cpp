@@ -0,0 +1,68 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "prime.h"
+
+using namespace std;
+using namespace simple_rsa;
+
+// the search keygen did before next_prime: sieve one candidate by
+// stepping it, then the full miller-rabin test, then a new candidate
+BigUint one_by_one(int bits) {
+  BigUint p;
+  for (;;) {
+    p.random_bits(bits);
+    primer_numbers_test(p);
+    if (miller_rabin_test(p)) {
+      return p;
+    }
+  }
+}
+
+// usage: bench_prime [primes per size]
+int main(int argc, char *argv[]) {
+  const int rounds = argc > 1 ? atoi(argv[1]) : 20;
+
+  // remainders by every small prime, the start of each sieve
+  vector<uint32_t> r(PRIME_NUMBERS_SIZE);
+  for (int bits : {512, 1024, 2048}) {
+    BigUint b;
+    b.random_bits(bits);
+    const int n = rounds * 50;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < n; ++i) {
+      for (int j = 0; j < PRIME_NUMBERS_SIZE; ++j) {
+        r[j] = b % PRIME_NUMBERS[j];
+      }
+    }
+    const double divide = chrono::duration<double>(chrono::steady_clock::now() - start).count() / n;
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < n; ++i) {
+      prime_remainders(b, r.data());
+    }
+    const double packed = chrono::duration<double>(chrono::steady_clock::now() - start).count() / n;
+    cout<<bits<<" bits, "<<PRIME_NUMBERS_SIZE<<" remainders: % "<<divide * 1e6
+        <<" us, packed "<<packed * 1e6<<" us"<<endl;
+  }
+  for (int bits : {512, 1024, 2048}) {
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) {
+      one_by_one(bits);
+    }
+    const double old = chrono::duration<double>(chrono::steady_clock::now() - start).count() / rounds;
+
+    prime_stats stats;
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) {
+      BigUint b;
+      b.random_bits(bits);
+      next_prime(b, &stats);
+    }
+    const double batch = chrono::duration<double>(chrono::steady_clock::now() - start).count() / rounds;
+    cout<<bits<<" bits: one by one "<<old * 1e3<<" ms, next_prime "<<batch * 1e3<<" ms"<<endl;
+    cout<<"  "<<stats.candidates / rounds<<" candidates per prime, rejected by sieve "
+        <<stats.sieve_rate() * 100<<"%, fermat "<<stats.fermat_rate() * 100
+        <<"%, miller-rabin "<<stats.miller_rabin_rate() * 100<<"%"<<endl;
+  }
+}
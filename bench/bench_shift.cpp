@@ -0,0 +1,51 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include "biguint.h"
+
+using namespace std;
+using namespace simple_rsa;
+
+// usage: bench_shift [rounds]
+int main(int argc, char *argv[]) {
+  const int rounds = argc > 1 ? atoi(argv[1]) : 200000;
+
+  // a left shift and the right shift back keep the size constant
+  const int bits[] = {1024, 2048, 4096};
+  const uint32_t shifts[] = {1, 32, 77};
+  for (int b : bits) {
+    BigUint x;
+    x.random_bits(b);
+    for (uint32_t s : shifts) {
+      auto start = chrono::steady_clock::now();
+      for (int i = 0; i < rounds; ++i) {
+        x.left_shift(s);
+        x.right_shift(s);
+      }
+      const double t = chrono::duration<double>(chrono::steady_clock::now() - start).count() / rounds;
+      cout<<b<<" bits, shift by "<<s<<": "<<t * 1e9 / 2<<" ns"<<endl;
+    }
+  }
+
+  // division normalizes both operands once per call
+  const int sizes[][2] = {{2048, 1024}, {1024, 512}, {4096, 2048}, {1100, 1024}};
+  for (auto& ab : sizes) {
+    BigUint a, b, r;
+    a.random_bits(ab[0]);
+    b.random_bits(ab[1]);
+    const int n = rounds / 20;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < n; ++i) {
+      r = a;
+      r %= b;
+    }
+    const double mod = chrono::duration<double>(chrono::steady_clock::now() - start).count() / n;
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < n; ++i) {
+      r = a;
+      r /= b;
+    }
+    const double div = chrono::duration<double>(chrono::steady_clock::now() - start).count() / n;
+    cout<<ab[0]<<" / "<<ab[1]<<" bits: %= "<<mod * 1e6<<" us, /= "<<div * 1e6<<" us"<<endl;
+  }
+}
@@ -1,13 +1,61 @@
+#include <algorithm>
 #include <cassert>
-#include <chrono>
+#include <cstring>
 #include <iomanip>
-#include <random>
 #include <sstream>
 
 #include "biguint.h"
+#include "drbg.h"
+#include "montgomery.h"
+#include "mpn.h"
+#include "scratch.h"
 
 namespace simple_rsa {
 
+namespace {
+
+// Knuth, TAOCP vol 2, 4.3.1, algorithm D on u[0..m+n] / v[0..n), n > 1,
+// v with its top bit set so every estimated quotient digit is at most 2
+// too large. leaves the remainder in u[0..n), the quotient in c[0..m]
+// unless c is null
+void divide_normalized(uint32_t *u, uint m, const uint32_t *v, uint n, uint32_t *c) {
+  const uint64_t v1 = v[n - 1], v2 = v[n - 2];
+  for (int j = m; j >= 0; --j) {
+    const uint64_t x = ((uint64_t)u[j + n] << 32) | u[j + n - 1];
+    uint64_t qhat = x / v1, rhat = x % v1;
+    while (qhat > UINT32_MAX || qhat * v2 > ((rhat << 32) | u[j + n - 2])) {
+      --qhat;
+      rhat += v1;
+      if (rhat > UINT32_MAX) {
+        break;
+      }
+    }
+    // u[j..j+n] -= qhat * v
+    const uint32_t top = u[j + n];
+    const uint32_t borrow = mpn::submul_1(u + j, v, n, qhat);
+    u[j + n] = top - borrow;
+    if (top < borrow) {
+      // qhat was one too large, add v back
+      --qhat;
+      u[j + n] += mpn::add_n(u + j, u + j, v, n);
+    }
+    if (c != nullptr) {
+      c[j] = qhat;
+    }
+  }
+}
+
+} // namespace
+
+BigUint::BigUint(const uint32_t *p, size_t n):_data(p, p + n) {
+  while (_data.size() > 1 && _data.back() == 0) {
+    _data.pop_back();
+  }
+  if (_data.empty()) {
+    _data.push_back(0);
+  }
+}
+
 std::string BigUint::to_string() const {
   std::stringstream ss;
   ss<<"0x";
@@ -17,39 +65,64 @@ std::string BigUint::to_string() const {
   return ss.str();
 }
 
+std::vector<uint8_t> BigUint::to_bytes(size_t len) const {
+  size_t n = (bits() + 7) / 8;
+  if (n < len) {
+    n = len;
+  }
+  std::vector<uint8_t> bytes(n);
+  for (size_t i = 0; i < n; ++i) {
+    size_t k = i / 4;
+    if (k < _data.size()) {
+      bytes[n - 1 - i] = _data[k] >> (i % 4 * 8);
+    }
+  }
+  return bytes;
+}
+
+BigUint BigUint::from_bytes(const uint8_t *p, size_t n) {
+  BigUint b;
+  b._data.assign((n + 3) / 4 + (n == 0), 0);
+  for (size_t i = 0; i < n; ++i) {
+    b._data[i / 4] |= (uint32_t)p[n - 1 - i] << (i % 4 * 8);
+  }
+  while (b._data.size() > 1 && b._data.back() == 0) {
+    b._data.pop_back();
+  }
+  return b;
+}
+
 void BigUint::shrink_to_fit() {
   _data.shrink_to_fit();
 }
 
 void BigUint::random_bits(int bits) {
   assert(bits > 0);
-  int n = bits / 32;
-  int m = bits % 32;
-  if (m == 0) {
-    --n;
-    m = 31;
-  }
+  // n: index of the most significant uint32, m: its top bit
+  const int n = (bits - 1) / 32;
+  const int m = (bits - 1) % 32;
   _data.resize(n + 1);
-  std::mt19937 generator(std::chrono::system_clock::now().time_since_epoch().count());
-  for (int i = 0; i <= n; ++i) {
-    _data[i] = generator();
-  }
-  _data[n] &= (1u << m) - 1;
+  Drbg::local().fill(_data.data(), n + 1);
+  _data[n] &= (2u << m) - 1;
   _data[n] |= 1u << m;
 }
 
 int BigUint::bits() const {
-  int bs = _data.size() * 32;
-  auto top = _data.back();
-  int p = 31;
-  while (p >= 0) {
-    p = 31;
-    uint32_t k = 1u << p;
-    if ((k & top) != 0) {
-      break;
-    }
+  int bs = (_data.size() - 1) * 32;
+  uint32_t top = _data.back();
+  while (top != 0) {
+    ++bs;
+    top >>= 1;
+  }
+  return bs;
+}
+
+void BigUint::set_bit(int i) {
+  assert(i >= 0);
+  if ((uint)i / 32 >= _data.size()) {
+    _data.resize(i / 32 + 1);
   }
-  return bs + p + 1;
+  _data[i / 32] |= 1u << (i % 32);
 }
 
 
@@ -88,82 +161,51 @@ void BigUint::_left_shift_(uint32_t n) {
   const uint x = n / 32, y = n % 32;
   if (y == 0) {
     _left_shift32_(x);
-  } else {
-    const uint32_t low = (1u << (32 - y)) - 1;
-    const uint32_t high = ~low;
-    const int old_size = _data.size();
-    _data.resize(old_size + x + 1);
-    for (int i = old_size - 1; i >= 0; --i) {
-      _data[i + x + 1] = (_data[i + 1] &  low) << y;
-      _data[i + x + 1] |= (_data[i] & high) >> (32 - y);
-    }
-    _data[x] = (_data[0] &  low) << y;
-    for (int i = x - 1; i >= 0; --i) {
-      _data[i] = 0;
-    }
-    if (_data.back() == 0 && _data.size() > 1) {
-      _data.pop_back();
-    }
-    assert (_data.back() != 0 || _data.size() == 1);
+    return;
   }
+  // shift straight into place, the kernel runs from the top down
+  const size_t size = _data.size();
+  _data.resize(size + x + 1);
+  uint32_t *p = _data.data();
+  p[size + x] = mpn::lshift(p + x, p, size, y);
+  std::memset(p, 0, x * sizeof(uint32_t));
+  _trim_();
 }
 
 void BigUint::_left_shift32_(uint s) {
   if (*this == 0 || s == 0) {
     return;
   }
-  uint old_size = _data.size();
-  _data.resize(old_size + s);
-  for (int i = old_size - 1; i >= 0; --i) {
-    _data[i + s] = _data[i];
-  }
-  for (uint i = 0; i < s; ++i) {
-    _data[i] = 0;
-  }
+  _data.insert(_data.begin(), s, 0);
 }
 
 
 void BigUint::_right_shift_(uint32_t n) {
-  if (*this == 0 || n == 0) {
-    return;
-  }
-  if (n >= (uint32_t)bits()) {
-    *this = 0;
+  const uint x = n / 32, y = n % 32;
+  if (x >= _data.size()) {
+    _set_uint32_(0);
     return;
   }
-  const uint x = n / 32, y = n % 32;
   if (y == 0) {
     _right_shift32_(x);
-  } else {
-    const uint32_t low = UINT32_MAX >> (32 - y);
-    const int old_size = _data.size();
-    size_t new_size = old_size - x;
-    _data.resize(new_size);
-    for (uint i = 0; i < new_size - 1; ++i) {
-      _data[i] = _data[i] >> y;
-      _data[i] |= (_data[i + 1] & low) << (32 - y);
-    }
-    _data[new_size - 1] = _data[new_size - 1] >> y;
-    if (_data.back() == 0 && _data.size() > 1) {
-      _data.pop_back();
-    }
-    assert (_data.back() != 0 || _data.size() == 1);
+    return;
   }
+  // shift straight into place, the kernel runs from the bottom up
+  const size_t size = _data.size() - x;
+  uint32_t *p = _data.data();
+  mpn::rshift(p, p + x, size, y);
+  _data.resize(size);
+  _trim_();
 }
 
 void BigUint::_right_shift32_(uint s) {
-  if (*this == 0 || s == 0) {
+  if (s == 0) {
     return;
   }
-  uint old_size = _data.size();
-  int new_size = old_size - s;
-  for (int i = 0; i < new_size; ++i) {
-    _data[i] = _data[i + s];
-  }
-  if (new_size <= 0) {
+  if (s >= _data.size()) {
     _set_uint32_(0);
   } else {
-    _data.resize(new_size);
+    _data.erase(_data.begin(), _data.begin() + s);
   }
 }
 
@@ -187,18 +229,24 @@ void BigUint::_div_and_mod_(uint32_t n, BigUint& q, uint32_t& r) const {
 
 
 BigUint BigUint::_montgomery_(const BigUint& a, const BigUint& b, uint32_t m) const {
-  BigUint t{0};
-  for (uint i = 0; i < _data.size(); ++i) {
-    uint32_t tb = 0;
-    if (i < b._data.size()) {
-      tb = b._data[i];
-    }
-    uint32_t q = (a._data[0] * tb + t._data[0]) * m;
-    t += *this * q + a * tb;
-    t._right_shift32_(1);
-    t %= *this;
-  }
-  return t;
+  assert(b._data.size() <= _data.size());
+  const size_t n = _data.size();
+  Scratch::Scope scratch;
+  uint32_t *ap = scratch.alloc(n);
+  uint32_t *bp = scratch.alloc(n);
+  uint32_t *tp = scratch.alloc(2 * n + 2);
+  if (a < *this) {
+    std::copy(a._data.begin(), a._data.end(), ap);
+    std::fill(ap + a._data.size(), ap + n, 0);
+  } else {
+    const BigUint r = a % *this;
+    std::copy(r._data.begin(), r._data.end(), ap);
+    std::fill(ap + r._data.size(), ap + n, 0);
+  }
+  std::copy(b._data.begin(), b._data.end(), bp);
+  std::fill(bp + b._data.size(), bp + n, 0);
+  mpn::mont_mul(ap, ap, bp, _data.data(), n, m, tp);
+  return BigUint(ap, n);
 }
 
 
@@ -220,16 +268,13 @@ BigUint& BigUint::operator+=(uint32_t n) {
 
 BigUint& BigUint::operator-=(uint32_t n) {
   assert(*this >= n);
-  union { struct {uint32_t l, h;} u32; uint64_t u64;} _u;
-  _u.u32 = {0, -n};
-  for (uint i = 0; i < _data.size(); ++i) {
-    _u.u64 = (int64_t)_data[i] + (int32_t)_u.u32.h;
-    _data[i] = _u.u32.l;
-    if (_u.u32.h == 0) {
-      break;
-    }
+  uint32_t borrow = n;
+  for (uint i = 0; i < _data.size() && borrow != 0; ++i) {
+    const uint32_t x = _data[i];
+    _data[i] = x - borrow;
+    borrow = x < borrow;
   }
-  if (_data.back() == 0 && _data.size() > 1) {
+  while (_data.back() == 0 && _data.size() > 1) {
     _data.pop_back();
   }
   assert (_data.back() != 0 || _data.size() == 1);
@@ -237,14 +282,13 @@ BigUint& BigUint::operator-=(uint32_t n) {
 }
 
 BigUint& BigUint::operator*=(uint32_t n) {
-  union { struct {uint32_t l, h;} u32; uint64_t u64;} _u;
-  _u.u32.h = 0;
-  for (uint i = 0; i < _data.size(); ++i) {
-    _u.u64 = (uint64_t)_data[i] * n + _u.u32.h;
-    _data[i] = _u.u32.l;
+  if (n == 0) {
+    _set_uint32_(0);
+    return *this;
   }
-  if (_u.u32.h > 0) {
-    _data.push_back(_u.u32.h);
+  uint32_t c = mpn::mul_1(_data.data(), _data.data(), _data.size(), n);
+  if (c > 0) {
+    _data.push_back(c);
   }
   return *this;
 }
@@ -311,102 +355,175 @@ BigUint& BigUint::operator-=(const BigUint& b) {
 }
 
 BigUint& BigUint::operator*=(const BigUint& b) {
-  uint m = _data.size(), n = b._data.size();
-  std::vector<uint32_t> c(m + n);
-  for (uint i = 0; i < m; ++i) {
-    union { struct {uint32_t l, h;} u32; uint64_t u64;} _u;
-    _u.u64 = 0;
-    for (uint j = 0; j < n; ++j) {
-      _u.u64 = (uint64_t)_data[i] * b._data[j]  + c[i + j] + _u.u32.h;
-      c[i + j] = _u.u32.l;
-    }
-    c[i + n] = _u.u32.h;
-  }
-  while (c.back() == 0 && c.size() > 1) {
-    c.pop_back();
-  }
-  assert (c.back() != 0 || c.size() == 1);
-  _data = std::move(c);
+  // the product is built in a new buffer, b may be *this
+  *this = BigUint(*this * b);
   return *this;
 }
 
 BigUint& BigUint::operator/=(const BigUint& b) {
+  BigUint q;
+  _div_mod_(b, &q);
+  *this = std::move(q);
+  return *this;
+}
+
+BigUint& BigUint::operator%=(const BigUint& b) {
+  _div_mod_(b, nullptr);
+  return *this;
+}
+
+void BigUint::_div_mod_(const BigUint& b, BigUint *q) {
   assert(b > 0);
-  if (*this == b) {
-    // *this = 1
-    _set_uint32_(1);
-  } else if (*this < b) {
-    // *this = 0
-    _set_uint32_(0);
-  } else {
-    const uint m = _data.size(), n = b._data.size();
-    std::vector<uint32_t> c(m - n + 1);
-    _data.push_back(0);
-    for (int i = m - n; i >= 0; --i) {
-      union { struct {uint32_t l, h;} u32; uint64_t u64;} _u;
-      _u.u32.h = _data[i + n];
-      _u.u32.l = _data[i + n - 1];
-      int64_t q = _u.u64 / b._data.back();
-      ++q;
-      BigUint bb;
-      do {
-        --q;
-        bb = b * (uint32_t)q;
-        if (bb._data.size() != n + 1) {
-          bb._data.resize(n + 1);
-        }
-      } while (q >= 0 && _compare_uint32_(bb._data.data(), _data.data() + i, bb._data.size()) > 0);
-      while (bb._data.back() == 0 && bb._data.size() > 1) {
-        bb._data.pop_back();
-      }
-      c[i] = q;
-      bb._left_shift32_(i);
-      *this -= bb;
+  if (*this < b) {
+    if (q != nullptr) {
+      q->_set_uint32_(0);
     }
-    while (c.back() == 0 && c.size() > 1) {
-      c.pop_back();
+    return;
+  }
+  if (b._data.size() == 1) {
+    BigUint t;
+    uint32_t r;
+    _div_and_mod_(b._data[0], t, r);
+    if (q != nullptr) {
+      *q = std::move(t);
     }
-    assert (c.back() != 0 || c.size() == 1);
-    _data = std::move(c);
+    _set_uint32_(r);
+    return;
+  }
+
+  // normalize so the divisor has its top bit set. the normalized
+  // operands and the quotient live in scratch memory
+  const uint s = 31 - (b.bits() - 1) % 32;
+  const uint n = b._data.size(), m = _data.size() - n;
+  Scratch::Scope scratch;
+  uint32_t *v = scratch.alloc(n);
+  uint32_t *u = scratch.alloc(m + n + 1);
+  uint32_t *c = scratch.alloc(m + 1);
+  mpn::lshift(v, b._data.data(), n, s);
+  u[m + n] = mpn::lshift(u, _data.data(), m + n, s);
+  divide_normalized(u, m, v, n, c);
+
+  // the remainder is in the low n uint32, still normalized
+  _data.resize(n);
+  mpn::rshift(_data.data(), u, n, s);
+  _trim_();
+  if (q != nullptr) {
+    q->_data.assign(c, c + m + 1);
+    q->_trim_();
   }
-  return *this;
 }
 
-BigUint& BigUint::operator%=(const BigUint& b) {
-  if (*this == b) {
-    // *this = 0
-    _set_uint32_(0);
-  } else if (*this > b) { // TODO: need be optimized
-    const uint m = _data.size(), n = b._data.size();
-    _data.push_back(0);
-    for (int i = m - n; i >= 0; --i) {
-      union { struct {uint32_t l, h;} u32; uint64_t u64;} _u;
-      _u.u32.h = _data[i + n];
-      _u.u32.l = _data[i + n - 1];
-      int64_t q = _u.u64 / b._data.back();
-      ++q;
-      BigUint bb;
-      do {
-        --q;
-        bb = b * (uint32_t)q;
-        if (bb._data.size() != n + 1) {
-          bb._data.resize(n + 1);
-        }
-      } while (q >= 0 && _compare_uint32_(bb._data.data(), _data.data() + i, bb._data.size()) > 0);
-      while (bb._data.back() == 0 && bb._data.size() > 1) {
-        bb._data.pop_back();
-      }
-      bb._left_shift32_(i);
-      *this -= bb;
-    }
-    while (_data.back() == 0 && _data.size() > 1) {
-      _data.pop_back();
+
+BigUint mul_mod(const BigUint& a, const BigUint& b, const BigUint& n) {
+  const uint an = a.size(), bn = b.size(), nn = n.size();
+  if (nn == 1 || an + bn < nn) {
+    BigUint c(a * b);
+    return c %= n;
+  }
+  // the product is built, normalized and reduced in scratch memory,
+  // only the remainder is copied out
+  const uint s = 31 - (n.bits() - 1) % 32;
+  const uint m = an + bn - nn;
+  Scratch::Scope scratch;
+  uint32_t *v = scratch.alloc(nn);
+  uint32_t *u = scratch.alloc(m + nn + 1);
+  mpn::lshift(v, n.data(), nn, s);
+  mpn::mul(u, a.data(), an, b.data(), bn);
+  u[m + nn] = mpn::lshift(u, u, m + nn, s);
+  divide_normalized(u, m, v, nn, nullptr);
+  mpn::rshift(u, u, nn, s);
+  return BigUint(u, nn);
+}
+
+
+BigUint::BigUint(const expr::scaled& e):_data(e.a.size() + 1) {
+  _data.back() = mpn::mul_1(_data.data(), e.a.data(), e.a.size(), e.k);
+  _trim_();
+}
+
+BigUint::BigUint(const expr::product& e):_data(e.a.size() + e.b.size()) {
+  mpn::mul(_data.data(), e.a.data(), e.a.size(), e.b.data(), e.b.size());
+  _trim_();
+}
+
+void BigUint::_add_at_(size_t i, uint64_t c) {
+  for (; c != 0; ++i) {
+    if (i == _data.size()) {
+      _data.push_back(0);
     }
-    assert (_data.back() != 0 || _data.size() == 1);
+    c += _data[i];
+    _data[i] = (uint32_t)c;
+    c >>= 32;
+  }
+}
+
+BigUint& BigUint::addmul_1(const BigUint& a, uint32_t k) {
+  const size_t n = a.size();
+  if (_data.size() < n) {
+    _data.resize(n);
   }
+  // a may be *this, take its data after resizing
+  const uint32_t c = mpn::addmul_1(_data.data(), a.data(), n, k);
+  _add_at_(n, c);
+  _trim_();
   return *this;
 }
 
+BigUint& BigUint::submul_1(const BigUint& a, uint32_t k) {
+  if (k == 0 || a == 0) {
+    return *this;
+  }
+  const size_t n = a.size();
+  assert(n <= _data.size());
+  uint32_t borrow = mpn::submul_1(_data.data(), a.data(), n, k);
+  borrow = mpn::sub_1(_data.data() + n, _data.size() - n, borrow);
+  assert(borrow == 0);
+  _trim_();
+  return *this;
+}
+
+BigUint& BigUint::addmul_2(const BigUint& a, uint32_t k, const BigUint& b, uint32_t j) {
+  if (a.size() < b.size()) {
+    return addmul_2(b, j, a, k);
+  }
+  const size_t na = a.size(), nb = b.size();
+  if (_data.size() < na) {
+    _data.resize(na);
+  }
+  uint32_t *rp = _data.data();
+  const uint64_t c1 = mpn::add2mul_1(rp, a.data(), k, b.data(), j, nb);
+  const uint32_t c2 = mpn::addmul_1(rp + nb, a.data() + nb, na - nb, k);
+  _add_at_(na, c2);
+  _add_at_(nb, c1);
+  _trim_();
+  return *this;
+}
+
+BigUint& BigUint::mul_add(const BigUint& a, const BigUint& b) {
+  if (&a == this || &b == this) {
+    return *this += BigUint(a * b);
+  }
+  const size_t na = a.size(), nb = b.size();
+  if (_data.size() < na + nb) {
+    _data.resize(na + nb);
+  }
+  for (size_t j = 0; j < nb; ++j) {
+    const uint32_t c = mpn::addmul_1(_data.data() + j, a.data(), na, b._data[j]);
+    _add_at_(j + na, c);
+  }
+  _trim_();
+  return *this;
+}
+
+uint32_t operator%(const BigUint& b, uint32_t n) {
+  assert(n > 0);
+  uint64_t r = 0;
+  for (size_t i = b.size(); i-- > 0;) {
+    r = ((r << 32) | b.data()[i]) % n;
+  }
+  return r;
+}
+
 
 BigUint BigUint::mod_mul_inv(uint32_t n) const {
   uint32_t r0 = n, r1;
@@ -432,7 +549,7 @@ BigUint BigUint::mod_mul_inv(uint32_t n) const {
         t2 -= t0;
         neg_2 = neg_1;
       } else {
-        t2 = t0 - t1;
+        t2 = t0 - t2;
         neg_2 = neg_0;
       }
     }
@@ -449,35 +566,46 @@ BigUint BigUint::mod_mul_inv(uint32_t n) const {
   return t0;
 }
 
-BigUint BigUint::mod_pow(const BigUint& b, const BigUint& e) const {
-  BigUint t{1};
-  t._left_shift32_(1);
-  BigUint x = t.mod_mul_inv(_data[0]);
-  assert(x > 0);
-  t -= std::move(x);
-  uint32_t m = t._data[0];
-
-  // bR mod(*this)
-  uint len = _data.size();
-  BigUint bR{b};
-  bR._left_shift32_(len);
-  bR %= *this;
-
-  // t = R
-  t = 1;
-  t._left_shift32_(len);
-  t %= *this;
-
-  for (int i = e._data.size() - 1; i >= 0; --i) {
-    for (int j = 31; j >= 0; --j) {
-      t = _montgomery_(t, t, m);
-      if ((e._data[i] & (1 << j)) != 0) {
-        t = _montgomery_(t, bR, m);
-      }
+BigUint BigUint::mod_mul_inv(const BigUint& n) const {
+  // t_i * n == (+/-)r_i mod(*this)
+  BigUint r0{*this}, r1 = n % *this;
+  BigUint t0{0}, t1{1};
+  bool neg_0 = false;
+  bool neg_1 = false;
+
+  while (r1 != 0) {
+    BigUint q = r0 / r1;
+    BigUint r2 = r0 - q * r1;
+    r0 = std::move(r1);
+    r1 = std::move(r2);
+    // t2 = t0 - q * t1
+    BigUint t2 = q * t1;
+    bool neg_2 = false;
+    if (neg_0 != neg_1) {
+      t2 += t0;
+      neg_2 = neg_0;
+    } else if (t2 >= t0) {
+      t2 -= t0;
+      neg_2 = !neg_0;
+    } else {
+      t2 = t0 - t2;
+      neg_2 = neg_0;
     }
+    t0 = std::move(t1);
+    t1 = std::move(t2);
+    neg_0 = neg_1;
+    neg_1 = neg_2;
+  }
+  if (r0 != 1) {
+    t0._set_uint32_(0);
+  } else if (neg_0 && t0 != 0) {
+    t0 = *this - t0;
   }
-  t = _montgomery_(t, 1, m);
-  return t;
+  return t0;
+}
+
+BigUint BigUint::mod_pow(const BigUint& b, const BigUint& e) const {
+  return Montgomery(*this).pow(b, e);
 }
 
 } // namespace simple_rsa
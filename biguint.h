@@ -8,16 +8,62 @@
 
 namespace simple_rsa {
 
+using std::uint8_t;
 using std::uint32_t;
 using std::uint64_t;
 typedef unsigned int uint;
 
+class BigUint;
+
+// lightweight expression templates. a * k and a * b with an lvalue a
+// are not evaluated on their own but fused into the destination, e.g.
+// t += x * k + y * j is one pass over t with no temporary. they hold
+// references, so they can not be copied or moved: auto x = a * b does
+// not compile, write BigUint x = a * b, or BigUint(a * b).to_string()
+// to call a member. with a temporary on the left, a * k and a * b are
+// a plain BigUint instead, a * k built in the temporary's buffer.
+namespace expr {
+
+// a * k
+struct scaled {
+  scaled(const scaled&) = delete;
+  scaled& operator=(const scaled&) = delete;
+  const BigUint& a;
+  uint32_t k;
+};
+
+// a * b
+struct product {
+  product(const product&) = delete;
+  product& operator=(const product&) = delete;
+  const BigUint& a;
+  const BigUint& b;
+};
+
+// l + r, the operands are temporaries of the same full expression
+template <class L, class R>
+struct sum {
+  sum(const sum&) = delete;
+  sum& operator=(const sum&) = delete;
+  const L& l;
+  const R& r;
+};
+
+} // namespace expr
+
 class BigUint {
 public:
   BigUint():_data{0} {}
   BigUint(uint32_t n):_data{n} {}
+  // from n little-endian uint32
+  BigUint(const uint32_t *p, size_t n);
   BigUint(const BigUint& other):_data{other._data} {}
   BigUint(BigUint&& rhs):_data{std::move(rhs._data)} {}
+  // evaluate an expression
+  BigUint(const expr::scaled& e);
+  BigUint(const expr::product& e);
+  template <class L, class R>
+  BigUint(const expr::sum<L, R>& e):BigUint(e.l) { *this += e.r; }
   ~BigUint() = default;
 
   BigUint& operator=(const BigUint& other) {
@@ -36,12 +82,26 @@ public:
   // hexadecimal format
   std::string to_string() const;
 
+  // big-endian bytes, zero padded on the left to at least len bytes
+  std::vector<uint8_t> to_bytes(size_t len = 0) const;
+  static BigUint from_bytes(const uint8_t *p, size_t n);
+
   // not exactly, multiple of 32
   void shrink_to_fit();
 
+  // little-endian uint32, size() >= 1
+  size_t size() const { return _data.size(); }
+  const uint32_t* data() const { return _data.data(); }
+
+  // exactly `bits` bits, drawn from the thread's Drbg
   void random_bits(int bits);
   int bits() const;
 
+  bool test_bit(int i) const {
+    return (uint)i / 32 < _data.size() && (_data[i / 32] & (1u << (i % 32))) != 0;
+  }
+  void set_bit(int i);
+
   bool is_odd() const { return (_data[0] & 0x1) != 0; }
   bool is_even() const { return (_data[0] & 0x1) == 0; }
 
@@ -55,7 +115,7 @@ public:
   bool operator<(uint32_t n) const { return _data.size() == 1 && _data[0] < n; }
   bool operator>(uint32_t n) const { return _data.size() > 1 || _data[0] > n; }
   bool operator==(uint32_t n) const { return _data.size() == 1 && _data[0] == n; }
-  bool operator!=(uint32_t n) const { return _data.size() == 1 || _data[0] != n; }
+  bool operator!=(uint32_t n) const { return _data.size() > 1 || _data[0] != n; }
   bool operator<=(uint32_t n) const { return _data.size() == 1 && _data[0] <= n; }
   bool operator>=(uint32_t n) const { return _data.size() > 1 || _data[0] >= n; }
 
@@ -77,16 +137,36 @@ public:
   BigUint& operator/=(const BigUint& b);
   BigUint& operator%=(const BigUint& b);
 
+  // fused operations, *this may be one of the operands
+  // *this += a * k
+  BigUint& addmul_1(const BigUint& a, uint32_t k);
+  // *this -= a * k, needs *this >= a * k
+  BigUint& submul_1(const BigUint& a, uint32_t k);
+  // *this += a * k + b * j
+  BigUint& addmul_2(const BigUint& a, uint32_t k, const BigUint& b, uint32_t j);
+  // *this += a * b
+  BigUint& mul_add(const BigUint& a, const BigUint& b);
+
+  BigUint& operator+=(const expr::scaled& e) { return addmul_1(e.a, e.k); }
+  BigUint& operator-=(const expr::scaled& e) { return submul_1(e.a, e.k); }
+  BigUint& operator+=(const expr::product& e) { return mul_add(e.a, e.b); }
+  BigUint& operator+=(const expr::sum<expr::scaled, expr::scaled>& e) {
+    return addmul_2(e.l.a, e.l.k, e.r.a, e.r.k);
+  }
+  template <class L, class R>
+  BigUint& operator+=(const expr::sum<L, R>& e) { *this += e.l; return *this += e.r; }
+
   // return *this << n
   BigUint& left_shift(uint32_t n) { this->_left_shift_(n); return *this;}
   BigUint left_shift(uint32_t n) const { BigUint b{*this}; b._left_shift_(n); return b;}
 
   // return *this >> n
-  BigUint& right_shift(uint32_t n) { this->_right_shift32_(n); return *this;}
+  BigUint& right_shift(uint32_t n) { this->_right_shift_(n); return *this;}
   BigUint right_shift(uint32_t n) const { BigUint b{*this}; b._right_shift_(n); return b;}
 
   // modular multiplicative inverse, n^(-1) mod(*this)
   BigUint mod_mul_inv(uint32_t n) const;
+  BigUint mod_mul_inv(const BigUint& n) const;
 
   // modular exponentiation, b^e mod(*this)
   BigUint mod_pow(const BigUint& b, const BigUint& e) const;
@@ -108,9 +188,22 @@ private:
   // right shift 32 * n bits
   void _right_shift32_(uint s);
 
+  // add c to the uint32 from i upwards, growing if needed
+  void _add_at_(size_t i, uint64_t c);
+  void _trim_() {
+    while (_data.back() == 0 && _data.size() > 1) {
+      _data.pop_back();
+    }
+  }
+
   // calculate q = *this / n; r = *this % n;
   void _div_and_mod_(uint32_t n, BigUint& q, uint32_t& r) const;
 
+  // *q = *this / b (if q is not null); *this = *this % b
+  void _div_mod_(const BigUint& b, BigUint *q);
+
+  friend class Montgomery;
+
   // montgomery multiplication, a*b*(R^-1) mod(*this)
   // r = 2^32, R = r^(*this.size()), m == r - (*this[0])^-1,
   // calculate m outside to avoid calculating every time in loop
@@ -131,9 +224,8 @@ inline BigUint operator-(const BigUint& b, uint32_t n) {
   return c -= n;
 }
 
-inline BigUint operator*(const BigUint& b, uint32_t n) {
-  BigUint c(b);
-  return c *= n;
+inline expr::scaled operator*(const BigUint& b, uint32_t n) {
+  return {b, n};
 }
 
 inline BigUint operator/(const BigUint& b, uint32_t n) {
@@ -141,11 +233,7 @@ inline BigUint operator/(const BigUint& b, uint32_t n) {
   return c /= n;
 }
 
-inline uint32_t operator%(const BigUint& b, uint32_t n) {
-  BigUint c(b);
-  c %= n;
-  return c.lsu();
-}
+uint32_t operator%(const BigUint& b, uint32_t n);
 
 
 inline BigUint operator+(const BigUint& b1, const BigUint& b2) {
@@ -158,9 +246,8 @@ inline BigUint operator-(const BigUint& b1, const BigUint& b2) {
   return c -= b2;
 }
 
-inline BigUint operator*(const BigUint& b1, const BigUint& b2) {
-  BigUint c(b1);
-  return c *= b2;
+inline expr::product operator*(const BigUint& b1, const BigUint& b2) {
+  return {b1, b2};
 }
 
 inline BigUint operator/(const BigUint& b1, const BigUint& b2) {
@@ -173,13 +260,49 @@ inline BigUint operator%(const BigUint& b1, const BigUint& b2) {
   return c %= b2;
 }
 
+// a * b mod(n), the product is reduced in scratch memory and only the
+// result is allocated
+BigUint mul_mod(const BigUint& a, const BigUint& b, const BigUint& n);
+
+
+// temporaries on the left are reused instead of copied
+inline BigUint operator+(BigUint&& b, uint32_t n) { return std::move(b += n); }
+inline BigUint operator-(BigUint&& b, uint32_t n) { return std::move(b -= n); }
+inline BigUint operator*(BigUint&& b, uint32_t n) { return std::move(b *= n); }
+inline BigUint operator/(BigUint&& b, uint32_t n) { return std::move(b /= n); }
+inline uint32_t operator%(BigUint&& b, uint32_t n) { return static_cast<const BigUint&>(b) % n; }
+inline BigUint operator+(BigUint&& b1, const BigUint& b2) { return std::move(b1 += b2); }
+inline BigUint operator-(BigUint&& b1, const BigUint& b2) { return std::move(b1 -= b2); }
+inline BigUint operator*(BigUint&& b1, const BigUint& b2) { return std::move(b1 *= b2); }
+inline BigUint operator/(BigUint&& b1, const BigUint& b2) { return std::move(b1 /= b2); }
+inline BigUint operator%(BigUint&& b1, const BigUint& b2) { return std::move(b1 %= b2); }
+
+
+inline expr::sum<expr::scaled, expr::scaled> operator+(const expr::scaled& l, const expr::scaled& r) {
+  return {l, r};
+}
+
+inline expr::sum<expr::product, expr::product> operator+(const expr::product& l, const expr::product& r) {
+  return {l, r};
+}
+
+inline expr::sum<expr::scaled, expr::product> operator+(const expr::scaled& l, const expr::product& r) {
+  return {l, r};
+}
+
+inline expr::sum<expr::product, expr::scaled> operator+(const expr::product& l, const expr::scaled& r) {
+  return {l, r};
+}
+
 
-extern const uint32_t PRIME_NUMBERS[];
+// odd primes below SMALL_PRIME_LIMIT, built at compile time
+extern const uint32_t *const PRIME_NUMBERS;
 extern const int PRIME_NUMBERS_SIZE;
 
 // make b and all PRIME_NUMBERS are relatively prime
 void primer_numbers_test(BigUint& b);
 
+// probabilistic primality test, bases are drawn from the thread's Drbg
 bool miller_rabin_test(const BigUint& b);
 
 } // namespace simple_rsa
@@ -0,0 +1,188 @@
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/random.h>
+#include <unistd.h>
+
+#include "drbg.h"
+
+namespace simple_rsa {
+
+namespace {
+
+inline uint32_t rotl(uint32_t x, int n) {
+  return (x << n) | (x >> (32 - n));
+}
+
+inline void quarter_round(uint32_t *x, int a, int b, int c, int d) {
+  x[a] += x[b]; x[d] = rotl(x[d] ^ x[a], 16);
+  x[c] += x[d]; x[b] = rotl(x[b] ^ x[c], 12);
+  x[a] += x[b]; x[d] = rotl(x[d] ^ x[a], 8);
+  x[c] += x[d]; x[b] = rotl(x[b] ^ x[c], 7);
+}
+
+void os_random(void *buf, size_t len) {
+  char *p = static_cast<char*>(buf);
+  while (len > 0) {
+    ssize_t r = getrandom(p, len, 0);
+    if (r < 0 && errno == EINTR) {
+      continue;
+    }
+    if (r < 0 && errno == ENOSYS) {
+      int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+      if (fd < 0) {
+        throw std::runtime_error("simple_rsa: no entropy source");
+      }
+      while (len > 0) {
+        r = read(fd, p, len);
+        if (r < 0 && errno == EINTR) {
+          continue;
+        }
+        if (r <= 0) {
+          close(fd);
+          throw std::runtime_error("simple_rsa: reading /dev/urandom failed");
+        }
+        p += r;
+        len -= r;
+      }
+      close(fd);
+      return;
+    }
+    if (r < 0) {
+      throw std::runtime_error("simple_rsa: getrandom failed");
+    }
+    p += r;
+    len -= r;
+  }
+}
+
+// bumped in the child of every fork, so fill() spots a fork with a
+// load instead of a getpid() system call per call
+std::atomic<uint64_t> fork_generation{1};
+
+void on_fork_child() {
+  fork_generation.fetch_add(1, std::memory_order_relaxed);
+}
+
+} // namespace
+
+void chacha20_block(const uint32_t in[16], uint32_t out[16]) {
+  uint32_t x[16];
+  std::memcpy(x, in, sizeof(x));
+  for (int i = 0; i < 10; ++i) {
+    quarter_round(x, 0, 4,  8, 12);
+    quarter_round(x, 1, 5,  9, 13);
+    quarter_round(x, 2, 6, 10, 14);
+    quarter_round(x, 3, 7, 11, 15);
+    quarter_round(x, 0, 5, 10, 15);
+    quarter_round(x, 1, 6, 11, 12);
+    quarter_round(x, 2, 7,  8, 13);
+    quarter_round(x, 3, 4,  9, 14);
+  }
+  for (int i = 0; i < 16; ++i) {
+    out[i] = x[i] + in[i];
+  }
+}
+
+
+Drbg::Drbg() {
+  _reseed_();
+}
+
+Drbg::Drbg(const uint32_t seed[8]) {
+  _seed_(seed);
+  _generation = 0;
+}
+
+Drbg::~Drbg() {
+  volatile uint32_t *p = _key;
+  for (int i = 0; i < 8; ++i) {
+    p[i] = 0;
+  }
+  p = _buffer;
+  for (int i = 0; i < WORDS; ++i) {
+    p[i] = 0;
+  }
+}
+
+void Drbg::_seed_(const uint32_t seed[8]) {
+  std::memcpy(_key, seed, sizeof(_key));
+  _counter = 0;
+  _refill_();
+}
+
+void Drbg::_reseed_() {
+  static const int registered = pthread_atfork(nullptr, nullptr, on_fork_child);
+  if (registered != 0) {
+    throw std::runtime_error("simple_rsa: pthread_atfork failed");
+  }
+  _generation = fork_generation.load(std::memory_order_relaxed);
+  uint32_t seed[8];
+  os_random(seed, sizeof(seed));
+  _seed_(seed);
+}
+
+void Drbg::_refill_() {
+  // "expand 32-byte k"
+  uint32_t in[16] = {0x61707865, 0x3320646e, 0x79622d32, 0x6b206574};
+  std::memcpy(in + 4, _key, sizeof(_key));
+  in[14] = 0;
+  in[15] = 0;
+  for (int i = 0; i < BLOCKS; ++i) {
+    in[12] = (uint32_t)_counter;
+    in[13] = (uint32_t)(_counter >> 32);
+    ++_counter;
+    chacha20_block(in, _buffer + i * 16);
+  }
+  std::memcpy(_key, _buffer, sizeof(_key));
+  std::memset(_buffer, 0, sizeof(_key));
+  _pos = 8;
+}
+
+uint32_t Drbg::next() {
+  uint32_t x;
+  fill(&x, 1);
+  return x;
+}
+
+void Drbg::fill(uint32_t *out, size_t n) {
+  if (_generation != 0 && _generation != fork_generation.load(std::memory_order_relaxed)) {
+    _reseed_();
+  }
+  while (n > 0) {
+    if (_pos == WORDS) {
+      _refill_();
+    }
+    size_t k = WORDS - _pos;
+    if (k > n) {
+      k = n;
+    }
+    std::memcpy(out, _buffer + _pos, k * sizeof(uint32_t));
+    std::memset(_buffer + _pos, 0, k * sizeof(uint32_t));
+    _pos += k;
+    out += k;
+    n -= k;
+  }
+}
+
+uint32_t Drbg::uniform(uint32_t n) {
+  assert(n > 0);
+  // reject the top partial range to avoid modulo bias
+  uint32_t limit = UINT32_MAX - UINT32_MAX % n;
+  uint32_t x;
+  do {
+    x = next();
+  } while (x >= limit);
+  return x % n;
+}
+
+Drbg& Drbg::local() {
+  static thread_local Drbg drbg;
+  return drbg;
+}
+
+} // namespace simple_rsa
@@ -0,0 +1,57 @@
+#ifndef _DRBG_H__
+#define _DRBG_H__ 1
+
+#include <cstddef>
+#include <cstdint>
+
+namespace simple_rsa {
+
+using std::uint32_t;
+using std::uint64_t;
+
+// chacha20 block function (RFC 7539), out = in + 20 rounds of in
+void chacha20_block(const uint32_t in[16], uint32_t out[16]);
+
+// ChaCha20 based random bit generator, seeded once from getrandom.
+// output is produced BLOCKS * 64 bytes at a time, the first 32 bytes
+// of every refill become the next key so earlier output can not be
+// recovered from the state (fast key erasure).
+class Drbg {
+public:
+  // seeded from the operating system
+  Drbg();
+  // deterministic, for tests only
+  explicit Drbg(const uint32_t seed[8]);
+  Drbg(const Drbg&) = delete;
+  Drbg& operator=(const Drbg&) = delete;
+  ~Drbg();
+
+  uint32_t next();
+  void fill(uint32_t *out, size_t n);
+
+  // uniform in [0, n), n > 0
+  uint32_t uniform(uint32_t n);
+
+  // generator of the calling thread, seeded on first use
+  static Drbg& local();
+
+private:
+  static const int BLOCKS = 16;
+  static const int WORDS = BLOCKS * 16;
+
+  void _seed_(const uint32_t seed[8]);
+  void _reseed_();
+  void _refill_();
+
+  uint32_t _key[8];
+  uint64_t _counter;
+  uint32_t _buffer[WORDS];
+  int _pos;
+  // fork generation at seeding time, a forked child must not repeat
+  // the parent. 0 for a deterministic generator, never reseeded
+  uint64_t _generation;
+};
+
+} // namespace simple_rsa
+
+#endif // _DRBG_H__
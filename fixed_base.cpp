@@ -0,0 +1,72 @@
+#include <cassert>
+
+#include "fixed_base.h"
+
+namespace simple_rsa {
+
+FixedBase::FixedBase(const Montgomery& mont, const BigUint& g, int max_bits, int h, int v)
+    :_mont{mont}, _g{g}, _max_bits{max_bits}, _h{h}, _v{v} {
+  assert(max_bits > 0 && h > 0 && h <= 16 && v > 0);
+  _a = (max_bits + h - 1) / h;
+  _b = (_a + v - 1) / v;
+  const uint rows = 1u << h;
+  _table.resize(rows * v);
+
+  // _table[2^i] = g^(2^(i*a))
+  BigUint x = _mont.to_mont(g);
+  for (int i = 0; i < h; ++i) {
+    _table[1u << i] = x;
+    if (i + 1 < h) {
+      for (int k = 0; k < _a; ++k) {
+        x = _mont.mul(x, x);
+      }
+    }
+  }
+  _table[0] = _mont.one();
+  for (uint u = 3; u < rows; ++u) {
+    uint low = u & (u - 1);
+    if (low != 0) {
+      _table[u] = _mont.mul(_table[low], _table[u ^ low]);
+    }
+  }
+  // column j is column j - 1 raised to 2^b
+  for (int j = 1; j < v; ++j) {
+    _table[j * rows] = _mont.one();
+    for (uint u = 1; u < rows; ++u) {
+      x = _table[(j - 1) * rows + u];
+      for (int k = 0; k < _b; ++k) {
+        x = _mont.mul(x, x);
+      }
+      _table[j * rows + u] = std::move(x);
+    }
+  }
+}
+
+BigUint FixedBase::pow(const BigUint& e) const {
+  if (e.bits() > _max_bits) {
+    return _mont.pow(_g, e);
+  }
+  const uint rows = 1u << _h;
+  BigUint t = _mont.one();
+  for (int k = _b - 1; k >= 0; --k) {
+    if (k != _b - 1) {
+      t = _mont.mul(t, t);
+    }
+    for (int j = _v - 1; j >= 0; --j) {
+      const int col = j * _b + k;
+      if (col >= _a) {
+        continue;
+      }
+      uint u = 0;
+      for (int i = _h - 1; i >= 0; --i) {
+        u = (u << 1) | e.test_bit(i * _a + col);
+      }
+      if (u != 0) {
+        t = _mont.mul(t, _table[j * rows + u]);
+      }
+    }
+  }
+  return _mont.from_mont(t);
+}
+
+} // namespace simple_rsa
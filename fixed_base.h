@@ -0,0 +1,43 @@
+#ifndef _FIXED_BASE_H__
+#define _FIXED_BASE_H__ 1
+
+#include <vector>
+
+#include "montgomery.h"
+
+namespace simple_rsa {
+
+// g^e mod(n) for one fixed g and many e, Lim-Lee comb method.
+// e of up to max_bits bits is cut into h rows of a = ceil(max_bits / h)
+// bits and every row into v columns of b = ceil(a / v) bits, with
+// v * (2^h - 1) powers of g stored, g^e takes b - 1 squarings and
+// at most a multiplications, against max_bits squarings and about
+// max_bits / 2 multiplications for plain square-and-multiply.
+class FixedBase {
+public:
+  FixedBase(const Montgomery& mont, const BigUint& g, int max_bits, int h = 6, int v = 2);
+
+  // longer exponents fall back to Montgomery::pow
+  BigUint pow(const BigUint& e) const;
+
+  const BigUint& base() const { return _g; }
+  // number of stored powers of g
+  size_t table_size() const { return _v * ((1u << _h) - 1); }
+
+private:
+  const Montgomery _mont;
+  const BigUint _g;
+  const int _max_bits;
+  const int _h;
+  const int _v;
+  // bits in a row and in a column
+  int _a;
+  int _b;
+  // _table[j * 2^h + u] = product of g^(2^(i*a + j*b)) over the bits i of u,
+  // in montgomery form
+  std::vector<BigUint> _table;
+};
+
+} // namespace simple_rsa
+
+#endif // _FIXED_BASE_H__
@@ -0,0 +1,115 @@
+#include <cassert>
+
+#include "key_cache.h"
+
+namespace simple_rsa {
+
+KeyCache::KeyCache(size_t memory_budget, loader load, int shards)
+    :_shard_budget{memory_budget / shards}, _load{std::move(load)},
+     _hits{0}, _misses{0}, _evictions{0} {
+  assert(shards > 0);
+  for (int i = 0; i < shards; ++i) {
+    _shards.emplace_back(new shard);
+  }
+}
+
+KeyCache::shard& KeyCache::_shard_(const std::string& id) {
+  return *_shards[std::hash<std::string>()(id) % _shards.size()];
+}
+
+KeyCache::context_ptr KeyCache::find(const std::string& id) {
+  shard& s = _shard_(id);
+  std::lock_guard<std::mutex> guard(s.lock);
+  auto it = s.index.find(id);
+  if (it == s.index.end()) {
+    return nullptr;
+  }
+  s.lru.splice(s.lru.begin(), s.lru, it->second);
+  return it->second->ctx;
+}
+
+KeyCache::context_ptr KeyCache::get(const std::string& id) {
+  context_ptr ctx = find(id);
+  if (ctx) {
+    ++_hits;
+    return ctx;
+  }
+  ++_misses;
+  if (!_load) {
+    return nullptr;
+  }
+  ctx = _load(id);
+  if (!ctx) {
+    return nullptr;
+  }
+  shard& s = _shard_(id);
+  std::lock_guard<std::mutex> guard(s.lock);
+  auto it = s.index.find(id);
+  if (it != s.index.end()) {
+    // loaded by another thread meanwhile
+    s.lru.splice(s.lru.begin(), s.lru, it->second);
+    return it->second->ctx;
+  }
+  _insert_(s, id, ctx);
+  return ctx;
+}
+
+void KeyCache::put(const std::string& id, context_ptr ctx) {
+  assert(ctx);
+  shard& s = _shard_(id);
+  std::lock_guard<std::mutex> guard(s.lock);
+  auto it = s.index.find(id);
+  if (it != s.index.end()) {
+    s.memory -= it->second->memory;
+    s.lru.erase(it->second);
+    s.index.erase(it);
+  }
+  _insert_(s, id, std::move(ctx));
+}
+
+void KeyCache::_insert_(shard& s, const std::string& id, context_ptr ctx) {
+  const size_t memory = ctx->memory() + id.size();
+  s.lru.push_front(entry{id, std::move(ctx), memory});
+  s.index[id] = s.lru.begin();
+  s.memory += memory;
+  // keep at least the new entry, even if it alone is over budget
+  while (s.memory > _shard_budget && s.lru.size() > 1) {
+    entry& last = s.lru.back();
+    s.memory -= last.memory;
+    s.index.erase(last.id);
+    s.lru.pop_back();
+    ++_evictions;
+  }
+}
+
+void KeyCache::erase(const std::string& id) {
+  shard& s = _shard_(id);
+  std::lock_guard<std::mutex> guard(s.lock);
+  auto it = s.index.find(id);
+  if (it != s.index.end()) {
+    s.memory -= it->second->memory;
+    s.lru.erase(it->second);
+    s.index.erase(it);
+  }
+}
+
+void KeyCache::clear() {
+  for (auto& s : _shards) {
+    std::lock_guard<std::mutex> guard(s->lock);
+    s->lru.clear();
+    s->index.clear();
+    s->memory = 0;
+  }
+}
+
+KeyCache::stats KeyCache::statistics() const {
+  stats st{_hits, _misses, _evictions, 0, 0};
+  for (auto& s : _shards) {
+    std::lock_guard<std::mutex> guard(s->lock);
+    st.entries += s->lru.size();
+    st.memory += s->memory;
+  }
+  return st;
+}
+
+} // namespace simple_rsa
@@ -0,0 +1,79 @@
+#ifndef _KEY_CACHE_H__
+#define _KEY_CACHE_H__ 1
+
+#include <atomic>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "rsa.h"
+
+namespace simple_rsa {
+
+// thread-safe LRU cache of rsa_context by key id, for services that
+// hold many keys. ids are hashed to independently locked shards, each
+// evicting its least recently used contexts beyond its share of the
+// memory budget. contexts are shared, an evicted one stays valid for
+// as long as a caller holds it.
+class KeyCache {
+public:
+  typedef std::shared_ptr<const rsa_context> context_ptr;
+  // builds the context of an id on a miss, e.g. from a key file
+  typedef std::function<context_ptr(const std::string&)> loader;
+
+  struct stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    size_t entries;
+    size_t memory;
+  };
+
+  KeyCache(size_t memory_budget, loader load, int shards = 16);
+  KeyCache(const KeyCache&) = delete;
+  KeyCache& operator=(const KeyCache&) = delete;
+
+  // cached context, loaded on a miss, nullptr if the loader gives none.
+  // the loader runs outside the shard lock, concurrent misses on one
+  // id may both load, the first to finish is kept.
+  context_ptr get(const std::string& id);
+  // cached context or nullptr, never loads
+  context_ptr find(const std::string& id);
+  void put(const std::string& id, context_ptr ctx);
+  void erase(const std::string& id);
+  void clear();
+
+  stats statistics() const;
+
+private:
+  struct entry {
+    std::string id;
+    context_ptr ctx;
+    size_t memory;
+  };
+  struct shard {
+    std::mutex lock;
+    std::list<entry> lru;  // most recently used first
+    std::unordered_map<std::string, std::list<entry>::iterator> index;
+    size_t memory = 0;
+  };
+
+  shard& _shard_(const std::string& id);
+  // *s must be locked
+  void _insert_(shard& s, const std::string& id, context_ptr ctx);
+
+  const size_t _shard_budget;
+  const loader _load;
+  std::vector<std::unique_ptr<shard>> _shards;
+  std::atomic<uint64_t> _hits;
+  std::atomic<uint64_t> _misses;
+  std::atomic<uint64_t> _evictions;
+};
+
+} // namespace simple_rsa
+
+#endif // _KEY_CACHE_H__
@@ -0,0 +1,517 @@
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "key_file.h"
+
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "key files are mapped in place, little-endian hosts only"
+#endif
+
+namespace simple_rsa {
+
+namespace {
+
+const char KEY_FILE_MAGIC[8] = {'S', 'R', 'S', 'A', 'K', 'E', 'Y', '\0'};
+const size_t KEY_FILE_HEADER = 16;
+
+struct field_entry {
+  uint32_t offset;
+  uint32_t limbs;
+};
+
+void key_error(const std::string& what) {
+  throw std::runtime_error("simple_rsa: " + what);
+}
+
+// ---- DER ----
+
+void der_length(std::vector<uint8_t>& out, size_t len) {
+  if (len < 0x80) {
+    out.push_back(len);
+    return;
+  }
+  int n = 0;
+  for (size_t l = len; l > 0; l >>= 8) {
+    ++n;
+  }
+  out.push_back(0x80 | n);
+  for (int i = n - 1; i >= 0; --i) {
+    out.push_back(len >> (i * 8));
+  }
+}
+
+void der_integer(std::vector<uint8_t>& out, const BigUint& b) {
+  std::vector<uint8_t> bytes = b.to_bytes(1);
+  bool pad = (bytes[0] & 0x80) != 0;
+  out.push_back(0x02);
+  der_length(out, bytes.size() + pad);
+  if (pad) {
+    out.push_back(0);
+  }
+  out.insert(out.end(), bytes.begin(), bytes.end());
+}
+
+class der_reader {
+public:
+  der_reader(const uint8_t *p, size_t n):_p{p}, _n{n}, _pos{0} {}
+
+  bool done() const { return _pos == _n; }
+  const uint8_t* here() const { return _p + _pos; }
+
+  // content length of the next element with the tag
+  size_t enter(uint8_t tag) {
+    if (_pos + 2 > _n || _p[_pos] != tag) {
+      key_error("malformed DER");
+    }
+    ++_pos;
+    size_t len = _p[_pos++];
+    if (len & 0x80) {
+      int k = len & 0x7f;
+      if (k == 0 || k > 4 || _pos + k > _n) {
+        key_error("malformed DER length");
+      }
+      len = 0;
+      for (int i = 0; i < k; ++i) {
+        len = (len << 8) | _p[_pos++];
+      }
+    }
+    if (len > _n - _pos) {
+      key_error("truncated DER");
+    }
+    return len;
+  }
+
+  void skip(size_t len) { _pos += len; }
+
+  BigUint integer() {
+    size_t len = enter(0x02);
+    if (len == 0 || (_p[_pos] & 0x80) != 0) {
+      key_error("negative or empty DER integer");
+    }
+    BigUint b = BigUint::from_bytes(_p + _pos, len);
+    _pos += len;
+    return b;
+  }
+
+private:
+  const uint8_t *_p;
+  size_t _n;
+  size_t _pos;
+};
+
+// ---- base64 ----
+
+const char BASE64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+std::string base64_encode(const std::vector<uint8_t>& in) {
+  std::string out;
+  size_t i = 0;
+  for (; i + 2 < in.size(); i += 3) {
+    uint32_t x = (in[i] << 16) | (in[i + 1] << 8) | in[i + 2];
+    out += BASE64[x >> 18];
+    out += BASE64[(x >> 12) & 63];
+    out += BASE64[(x >> 6) & 63];
+    out += BASE64[x & 63];
+  }
+  if (i + 1 == in.size()) {
+    uint32_t x = in[i] << 16;
+    out += BASE64[x >> 18];
+    out += BASE64[(x >> 12) & 63];
+    out += "==";
+  } else if (i + 2 == in.size()) {
+    uint32_t x = (in[i] << 16) | (in[i + 1] << 8);
+    out += BASE64[x >> 18];
+    out += BASE64[(x >> 12) & 63];
+    out += BASE64[(x >> 6) & 63];
+    out += '=';
+  }
+  return out;
+}
+
+std::vector<uint8_t> base64_decode(const std::string& in) {
+  std::vector<uint8_t> out;
+  uint32_t x = 0;
+  int n = 0;
+  for (char c : in) {
+    if (c == '=') {
+      break;
+    }
+    const char *p = c == '\0' ? nullptr : std::strchr(BASE64, c);
+    if (p == nullptr) {
+      if (c == '\n' || c == '\r' || c == ' ' || c == '\t') {
+        continue;
+      }
+      key_error("invalid base64");
+    }
+    x = (x << 6) | (p - BASE64);
+    if (++n == 4) {
+      out.push_back(x >> 16);
+      out.push_back(x >> 8);
+      out.push_back(x);
+      x = 0;
+      n = 0;
+    }
+  }
+  if (n == 2) {
+    out.push_back(x >> 4);
+  } else if (n == 3) {
+    out.push_back(x >> 10);
+    out.push_back(x >> 2);
+  }
+  return out;
+}
+
+// the field of the montgomery m of a modulus, R^2 follows it
+int montgomery_field(key_field modulus) {
+  switch (modulus) {
+  case KEY_N: return KEY_N_M;
+  case KEY_P: return KEY_P_M;
+  case KEY_Q: return KEY_Q_M;
+  case KEY_R3: return KEY_R3_M;
+  case KEY_R4: return KEY_R4_M;
+  default: return -1;
+  }
+}
+
+// private keys are created 0600, an existing file is cut to that too
+void write_file(const std::string& path, const char *data, size_t size, bool secret) {
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, secret ? 0600 : 0644);
+  if (fd < 0 || (secret && fchmod(fd, 0600) != 0)) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    key_error("can not write " + path);
+  }
+  while (size > 0) {
+    ssize_t w = write(fd, data, size);
+    if (w < 0 && errno == EINTR) {
+      continue;
+    }
+    if (w <= 0) {
+      close(fd);
+      key_error("can not write " + path);
+    }
+    data += w;
+    size -= w;
+  }
+  if (close(fd) != 0) {
+    key_error("can not write " + path);
+  }
+}
+
+const char PEM_PRIVATE[] = "RSA PRIVATE KEY";
+const char PEM_PUBLIC[] = "RSA PUBLIC KEY";
+
+} // namespace
+
+
+void save_key_file(const std::string& path, const rsa_key& key, bool montgomery) {
+  if (key.primes() > (size_t)rsa::MAX_PRIMES) {
+    key_error("too many primes for a key file");
+  }
+  BigUint fields[KEY_FIELDS] = {key.n, key.e, key.d, key.p, key.q, key.dp, key.dq, key.qinv};
+  for (size_t i = 0; i < key.others.size(); ++i) {
+    const int r = key_prime_field(i + 2);
+    fields[r] = key.others[i].r;
+    fields[r + 1] = key.others[i].d;
+    fields[r + 2] = key.others[i].t;
+  }
+  if (montgomery) {
+    for (key_field modulus : {KEY_N, KEY_P, KEY_Q, KEY_R3, KEY_R4}) {
+      const BigUint& b = fields[modulus];
+      if (b > 1 && b.is_odd()) {
+        Montgomery mont(b);
+        fields[montgomery_field(modulus)] = mont.m();
+        fields[montgomery_field(modulus) + 1] = mont.r2();
+      }
+    }
+  }
+
+  field_entry table[KEY_FIELDS];
+  size_t offset = KEY_FILE_HEADER + sizeof(table);
+  for (int i = 0; i < KEY_FIELDS; ++i) {
+    offset = (offset + 7) & ~(size_t)7;
+    table[i].offset = offset;
+    table[i].limbs = fields[i] == 0 ? 0 : fields[i].size();
+    offset += table[i].limbs * sizeof(uint32_t);
+  }
+
+  std::vector<char> buf(offset);
+  std::memcpy(buf.data(), KEY_FILE_MAGIC, sizeof(KEY_FILE_MAGIC));
+  const uint32_t header[2] = {KEY_FILE_VERSION, KEY_FIELDS};
+  std::memcpy(buf.data() + 8, header, sizeof(header));
+  std::memcpy(buf.data() + KEY_FILE_HEADER, table, sizeof(table));
+  for (int i = 0; i < KEY_FIELDS; ++i) {
+    std::memcpy(buf.data() + table[i].offset, fields[i].data(), table[i].limbs * sizeof(uint32_t));
+  }
+
+  write_file(path, buf.data(), buf.size(), key.is_private());
+}
+
+
+KeyFile::KeyFile(const std::string& path):_map{nullptr}, _size{0}, _count{0} {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    key_error("can not open " + path);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)KEY_FILE_HEADER) {
+    close(fd);
+    key_error("not a key file: " + path);
+  }
+  _size = st.st_size;
+  _map = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (_map == MAP_FAILED) {
+    _map = nullptr;
+    key_error("can not map " + path);
+  }
+
+  const char *base = static_cast<const char*>(_map);
+  uint32_t header[2];
+  std::memcpy(header, base + 8, sizeof(header));
+  if (std::memcmp(base, KEY_FILE_MAGIC, sizeof(KEY_FILE_MAGIC)) != 0 ||
+      header[0] < 1 || header[0] > KEY_FILE_VERSION ||
+      KEY_FILE_HEADER + (size_t)header[1] * sizeof(field_entry) > _size) {
+    munmap(_map, _size);
+    key_error("not a key file: " + path);
+  }
+  _count = header[1];
+  const field_entry *table = reinterpret_cast<const field_entry*>(base + KEY_FILE_HEADER);
+  for (uint32_t i = 0; i < _count; ++i) {
+    if (table[i].offset % 8 != 0 ||
+        table[i].offset > _size ||
+        (size_t)table[i].limbs * sizeof(uint32_t) > _size - table[i].offset) {
+      munmap(_map, _size);
+      key_error("corrupted key file: " + path);
+    }
+  }
+}
+
+KeyFile::~KeyFile() {
+  if (_map != nullptr) {
+    munmap(_map, _size);
+  }
+}
+
+const uint32_t* KeyFile::field(key_field f, size_t& limbs) const {
+  limbs = 0;
+  if ((uint32_t)f >= _count) {
+    return nullptr;
+  }
+  const char *base = static_cast<const char*>(_map);
+  const field_entry& entry = reinterpret_cast<const field_entry*>(base + KEY_FILE_HEADER)[f];
+  if (entry.limbs == 0) {
+    return nullptr;
+  }
+  limbs = entry.limbs;
+  return reinterpret_cast<const uint32_t*>(base + entry.offset);
+}
+
+BigUint KeyFile::_get_(key_field f) const {
+  size_t limbs;
+  const uint32_t *p = field(f, limbs);
+  return BigUint(p, limbs);
+}
+
+rsa_key KeyFile::key() const {
+  rsa_key k;
+  k.n = _get_(KEY_N);
+  k.e = _get_(KEY_E);
+  k.d = _get_(KEY_D);
+  k.p = _get_(KEY_P);
+  k.q = _get_(KEY_Q);
+  k.dp = _get_(KEY_DP);
+  k.dq = _get_(KEY_DQ);
+  k.qinv = _get_(KEY_QINV);
+  size_t limbs;
+  for (size_t i = 2; i < (size_t)rsa::MAX_PRIMES && field(key_prime_field(i), limbs) != nullptr; ++i) {
+    const key_field r = key_prime_field(i);
+    rsa_prime o;
+    o.r = _get_(r);
+    o.d = _get_((key_field)(r + 1));
+    o.t = _get_((key_field)(r + 2));
+    k.others.push_back(std::move(o));
+  }
+  return k;
+}
+
+bool KeyFile::has_montgomery(key_field modulus) const {
+  const int i = montgomery_field(modulus);
+  size_t m, r2;
+  return i >= 0 &&
+         field(modulus, m) != nullptr &&
+         field((key_field)i, m) != nullptr &&
+         field((key_field)(i + 1), r2) != nullptr;
+}
+
+Montgomery KeyFile::montgomery(key_field modulus) const {
+  const BigUint n = _get_(modulus);
+  if (n <= 1 || !n.is_odd()) {
+    key_error("corrupted key file: modulus is not odd");
+  }
+  if (!has_montgomery(modulus)) {
+    return Montgomery(n);
+  }
+  // Montgomery only asserts these, the file is not trusted
+  const int i = montgomery_field(modulus);
+  size_t limbs;
+  const uint32_t m = *field((key_field)i, limbs);
+  const BigUint r2 = _get_((key_field)(i + 1));
+  if (limbs != 1 || (uint32_t)(n.lsu() * m) != UINT32_MAX ||
+      r2.size() > n.size() || r2 >= n) {
+    key_error("corrupted key file: bad montgomery constants");
+  }
+  return Montgomery(n, m, r2);
+}
+
+
+std::vector<uint8_t> to_der(const rsa_key& key) {
+  std::vector<uint8_t> body;
+  if (key.is_private()) {
+    der_integer(body, key.others.empty() ? 0 : 1);
+    der_integer(body, key.n);
+    der_integer(body, key.e);
+    der_integer(body, key.d);
+    der_integer(body, key.p);
+    der_integer(body, key.q);
+    der_integer(body, key.dp);
+    der_integer(body, key.dq);
+    der_integer(body, key.qinv);
+    if (!key.others.empty()) {
+      std::vector<uint8_t> infos;
+      for (const rsa_prime& o : key.others) {
+        std::vector<uint8_t> info;
+        der_integer(info, o.r);
+        der_integer(info, o.d);
+        der_integer(info, o.t);
+        infos.push_back(0x30);
+        der_length(infos, info.size());
+        infos.insert(infos.end(), info.begin(), info.end());
+      }
+      body.push_back(0x30);
+      der_length(body, infos.size());
+      body.insert(body.end(), infos.begin(), infos.end());
+    }
+  } else {
+    der_integer(body, key.n);
+    der_integer(body, key.e);
+  }
+  std::vector<uint8_t> der{0x30};
+  der_length(der, body.size());
+  der.insert(der.end(), body.begin(), body.end());
+  return der;
+}
+
+rsa_key from_der(const uint8_t *p, size_t n) {
+  der_reader outer(p, n);
+  size_t len = outer.enter(0x30);
+  der_reader r(outer.here(), len);
+  rsa_key k;
+  BigUint first = r.integer();
+  BigUint second = r.integer();
+  if (r.done()) {
+    // RSAPublicKey
+    k.n = std::move(first);
+    k.e = std::move(second);
+    return k;
+  }
+  if (first != 0 && first != 1) {
+    key_error("unsupported RSAPrivateKey version");
+  }
+  k.n = std::move(second);
+  k.e = r.integer();
+  k.d = r.integer();
+  k.p = r.integer();
+  k.q = r.integer();
+  k.dp = r.integer();
+  k.dq = r.integer();
+  k.qinv = r.integer();
+  if (first == 1) {
+    // OtherPrimeInfos, at least one
+    const size_t len = r.enter(0x30);
+    der_reader infos(r.here(), len);
+    r.skip(len);
+    do {
+      const size_t info_len = infos.enter(0x30);
+      der_reader info(infos.here(), info_len);
+      infos.skip(info_len);
+      rsa_prime o;
+      o.r = info.integer();
+      o.d = info.integer();
+      o.t = info.integer();
+      k.others.push_back(std::move(o));
+    } while (!infos.done());
+  }
+  return k;
+}
+
+std::string to_pem(const rsa_key& key) {
+  const char *label = key.is_private() ? PEM_PRIVATE : PEM_PUBLIC;
+  std::string b64 = base64_encode(to_der(key));
+  std::string pem = std::string("-----BEGIN ") + label + "-----\n";
+  for (size_t i = 0; i < b64.size(); i += 64) {
+    pem += b64.substr(i, 64) + "\n";
+  }
+  pem += std::string("-----END ") + label + "-----\n";
+  return pem;
+}
+
+rsa_key from_pem(const std::string& pem) {
+  size_t begin = pem.find("-----BEGIN ");
+  size_t label_end = begin == std::string::npos ? begin : pem.find("-----", begin + 11);
+  // the body starts after the line end, \n or \r\n
+  size_t body = label_end == std::string::npos ? label_end : label_end + 5;
+  if (body < pem.size() && pem[body] == '\r') {
+    ++body;
+  }
+  if (body >= pem.size() || pem[body] != '\n') {
+    key_error("malformed PEM");
+  }
+  ++body;
+  size_t end = pem.find("-----END ", body);
+  if (end == std::string::npos) {
+    key_error("malformed PEM");
+  }
+  std::string label = pem.substr(begin + 11, label_end - begin - 11);
+  if (label != PEM_PRIVATE && label != PEM_PUBLIC) {
+    key_error("unsupported PEM type " + label);
+  }
+  std::vector<uint8_t> der = base64_decode(pem.substr(body, end - body));
+  return from_der(der.data(), der.size());
+}
+
+rsa_key load_key(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    key_error("can not open " + path);
+  }
+  char magic[sizeof(KEY_FILE_MAGIC)] = {0};
+  in.read(magic, sizeof(magic));
+  if (std::memcmp(magic, KEY_FILE_MAGIC, sizeof(magic)) == 0) {
+    return KeyFile(path).key();
+  }
+  std::stringstream ss;
+  in.clear();
+  in.seekg(0);
+  ss<<in.rdbuf();
+  return from_pem(ss.str());
+}
+
+void save_key(const std::string& path, const rsa_key& key, bool pem) {
+  if (!pem) {
+    save_key_file(path, key);
+    return;
+  }
+  const std::string text = to_pem(key);
+  write_file(path, text.data(), text.size(), key.is_private());
+}
+
+} // namespace simple_rsa
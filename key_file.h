@@ -0,0 +1,82 @@
+#ifndef _KEY_FILE_H__
+#define _KEY_FILE_H__ 1
+
+#include <string>
+#include <vector>
+
+#include "montgomery.h"
+#include "rsa.h"
+
+namespace simple_rsa {
+
+// binary key file:
+//   char     magic[8]    "SRSAKEY\0"
+//   uint32_t version     KEY_FILE_VERSION
+//   uint32_t count       number of entries in the field table
+//   struct { uint32_t offset, limbs; } table[count]
+// followed by the fields as little-endian uint32 limbs, every field
+// starts at a multiple of 8 bytes, so a mapped file is used in place.
+// a field with 0 limbs is absent. version 1 files end at KEY_Q_R2.
+enum key_field {
+  KEY_N, KEY_E, KEY_D, KEY_P, KEY_Q, KEY_DP, KEY_DQ, KEY_QINV,
+  // montgomery constants m (a single limb) and R^2 of n, p and q
+  KEY_N_M, KEY_N_R2, KEY_P_M, KEY_P_R2, KEY_Q_M, KEY_Q_R2,
+  // third and fourth prime of a multi-prime key: r, d, t as in
+  // rsa_prime and the montgomery constants of r
+  KEY_R3, KEY_D3, KEY_T3, KEY_R3_M, KEY_R3_R2,
+  KEY_R4, KEY_D4, KEY_T4, KEY_R4_M, KEY_R4_R2,
+  KEY_FIELDS
+};
+
+const uint32_t KEY_FILE_VERSION = 2;
+
+// KEY_P, KEY_Q, KEY_R3 or KEY_R4 for rsa_key::prime(i)
+inline key_field key_prime_field(size_t i) {
+  return i == 0 ? KEY_P : i == 1 ? KEY_Q : (key_field)(KEY_R3 + (i - 2) * (KEY_R4 - KEY_R3));
+}
+
+void save_key_file(const std::string& path, const rsa_key& key, bool montgomery = true);
+
+// read-only mapping of a binary key file
+class KeyFile {
+public:
+  explicit KeyFile(const std::string& path);
+  KeyFile(const KeyFile&) = delete;
+  KeyFile& operator=(const KeyFile&) = delete;
+  ~KeyFile();
+
+  // limbs of a field inside the mapping, nullptr if absent
+  const uint32_t* field(key_field f, size_t& limbs) const;
+
+  rsa_key key() const;
+
+  // montgomery constants of KEY_N or a key_prime_field are stored
+  bool has_montgomery(key_field modulus) const;
+  // the stored constants after a sanity check, computed when absent.
+  // throws on an even modulus or constants that do not fit it
+  Montgomery montgomery(key_field modulus) const;
+
+private:
+  BigUint _get_(key_field f) const;
+
+  void *_map;
+  size_t _size;
+  uint32_t _count;
+};
+
+// PKCS#1 RSAPrivateKey, version 1 with otherPrimeInfos for a
+// multi-prime key, or RSAPublicKey for a key without d
+std::vector<uint8_t> to_der(const rsa_key& key);
+rsa_key from_der(const uint8_t *p, size_t n);
+
+// "RSA PRIVATE KEY" or "RSA PUBLIC KEY" PEM
+std::string to_pem(const rsa_key& key);
+rsa_key from_pem(const std::string& pem);
+
+// binary key file or PEM, told apart by the content
+rsa_key load_key(const std::string& path);
+void save_key(const std::string& path, const rsa_key& key, bool pem = false);
+
+} // namespace simple_rsa
+
+#endif // _KEY_FILE_H__
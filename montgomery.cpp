@@ -0,0 +1,130 @@
+#include <algorithm>
+#include <cassert>
+
+#include "montgomery.h"
+#include "mpn.h"
+#include "scratch.h"
+
+namespace simple_rsa {
+
+namespace {
+
+// r[0..n) = x zero padded
+void load(uint32_t *r, const BigUint& x, size_t n) {
+  assert(x.size() <= n);
+  std::copy(x.data(), x.data() + x.size(), r);
+  std::fill(r + x.size(), r + n, 0);
+}
+
+} // namespace
+
+Montgomery::Montgomery(const BigUint& n):_n{n} {
+  assert(n.is_odd() && n > 1);
+  // newton iteration, every step doubles the correct low bits of n0^(-1)
+  const uint32_t n0 = n.lsu();
+  uint32_t x = n0;
+  for (int i = 0; i < 4; ++i) {
+    x *= 2 - n0 * x;
+  }
+  _m = -x;
+
+  _r2 = 1;
+  _r2.left_shift(64 * n.size());
+  _r2 %= _n;
+  _one = from_mont(_r2);
+}
+
+Montgomery::Montgomery(const BigUint& n, uint32_t m, const BigUint& r2)
+    :_n{n}, _m{m}, _r2{r2} {
+  assert(n.is_odd() && (uint32_t)(n.lsu() * m) == UINT32_MAX);
+  _one = from_mont(_r2);
+}
+
+Montgomery::exponent Montgomery::recode(const BigUint& e, int window) {
+  const int bits = e.bits();
+  if (window <= 0) {
+    window = bits > 671 ? 6 :
+             bits > 239 ? 5 :
+             bits >  79 ? 4 :
+             bits >  23 ? 3 : 1;
+  }
+  assert(window <= 8);
+  exponent x;
+  x.window = window;
+  for (int i = (bits + window - 1) / window - 1; i >= 0; --i) {
+    uint8_t d = 0;
+    for (int j = window - 1; j >= 0; --j) {
+      d = (d << 1) | e.test_bit(i * window + j);
+    }
+    if (d != 0 || !x.digits.empty()) {
+      x.digits.push_back(d);
+    }
+  }
+  return x;
+}
+
+BigUint Montgomery::pow(const BigUint& b, const exponent& e) const {
+  Scratch::Scope scratch;
+  uint32_t *x = scratch.alloc(size());
+  to_mont(x, b);
+  pow(x, x, e);
+  return from_mont(x);
+}
+
+void Montgomery::mul(uint32_t *r, const uint32_t *a, const uint32_t *b) const {
+  Scratch::Scope scratch;
+  uint32_t *tp = scratch.alloc(2 * size() + 2);
+  mpn::mont_mul(r, a, b, _n.data(), size(), _m, tp);
+}
+
+void Montgomery::to_mont(uint32_t *r, const BigUint& a) const {
+  const size_t n = size();
+  Scratch::Scope scratch;
+  uint32_t *r2 = scratch.alloc(n);
+  load(r2, _r2, n);
+  if (a < _n) {
+    load(r, a, n);
+  } else {
+    load(r, a % _n, n);
+  }
+  mul(r, r, r2);
+}
+
+BigUint Montgomery::from_mont(const uint32_t *a) const {
+  const size_t n = size();
+  Scratch::Scope scratch;
+  uint32_t *x = scratch.alloc(n);
+  std::fill(x, x + n, 0);
+  x[0] = 1;
+  mul(x, a, x);
+  return BigUint(x, n);
+}
+
+void Montgomery::pow(uint32_t *r, const uint32_t *b, const exponent& e) const {
+  const size_t n = size();
+  if (e.digits.empty()) {
+    load(r, _one, n);
+    return;
+  }
+  Scratch::Scope scratch;
+  uint32_t *tp = scratch.alloc(2 * n + 2);
+  // table[i] = (b^i)R mod(n), n uint32 each
+  const size_t size = 1u << e.window;
+  uint32_t *table = scratch.alloc(size * n);
+  load(table, _one, n);
+  std::copy(b, b + n, table + n);
+  for (size_t i = 2; i < size; ++i) {
+    mpn::mont_mul(table + i * n, table + (i - 1) * n, table + n, _n.data(), n, _m, tp);
+  }
+  std::copy(table + e.digits[0] * n, table + (e.digits[0] + 1) * n, r);
+  for (size_t i = 1; i < e.digits.size(); ++i) {
+    for (int j = 0; j < e.window; ++j) {
+      mpn::mont_mul(r, r, r, _n.data(), n, _m, tp);
+    }
+    if (e.digits[i] != 0) {
+      mpn::mont_mul(r, r, table + e.digits[i] * n, _n.data(), n, _m, tp);
+    }
+  }
+}
+
+} // namespace simple_rsa
@@ -0,0 +1,62 @@
+#ifndef _MONTGOMERY_H__
+#define _MONTGOMERY_H__ 1
+
+#include "biguint.h"
+
+namespace simple_rsa {
+
+// constants for montgomery multiplication modulo an odd n,
+// r = 2^32, R = r^(n.size()), m = -n^(-1) mod r
+class Montgomery {
+public:
+  explicit Montgomery(const BigUint& n);
+  // from precomputed constants, e.g. loaded from a key file
+  Montgomery(const BigUint& n, uint32_t m, const BigUint& r2);
+
+  const BigUint& modulus() const { return _n; }
+  uint32_t m() const { return _m; }
+  // R^2 mod(n)
+  const BigUint& r2() const { return _r2; }
+  // R mod(n), montgomery form of 1
+  const BigUint& one() const { return _one; }
+
+  // a*b*(R^-1) mod(n), b < R
+  BigUint mul(const BigUint& a, const BigUint& b) const { return _n._montgomery_(a, b, _m); }
+  // aR mod(n)
+  BigUint to_mont(const BigUint& a) const { return mul(a, _r2); }
+  // a*(R^-1) mod(n)
+  BigUint from_mont(const BigUint& a) const { return mul(a, 1); }
+
+  // e split into fixed windows, reusable for every base and modulus
+  struct exponent {
+    int window;
+    // most significant first, no leading zero digit
+    std::vector<uint8_t> digits;
+  };
+  // window == 0 chooses it by the size of e
+  static exponent recode(const BigUint& e, int window = 0);
+
+  // b^e mod(n)
+  BigUint pow(const BigUint& b, const BigUint& e) const { return pow(b, recode(e)); }
+  BigUint pow(const BigUint& b, const exponent& e) const;
+
+  // the same on size() uint32 arrays, e.g. from Scratch, for loops that
+  // should not touch the heap. r may be an operand, a < n
+  size_t size() const { return _n.size(); }
+  void mul(uint32_t *r, const uint32_t *a, const uint32_t *b) const;
+  // r = aR mod(n)
+  void to_mont(uint32_t *r, const BigUint& a) const;
+  BigUint from_mont(const uint32_t *a) const;
+  // r = (b^e)R mod(n) from b = bR mod(n)
+  void pow(uint32_t *r, const uint32_t *b, const exponent& e) const;
+
+private:
+  BigUint _n;
+  uint32_t _m;
+  BigUint _r2;
+  BigUint _one;
+};
+
+} // namespace simple_rsa
+
+#endif // _MONTGOMERY_H__
@@ -0,0 +1,100 @@
+#ifndef _MPMC_QUEUE_H__
+#define _MPMC_QUEUE_H__ 1
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace simple_rsa {
+
+// bounded lock-free multi-producer multi-consumer queue (D. Vyukov).
+// every cell carries a sequence number that tells producers and
+// consumers whose turn it is, a position is claimed with one CAS and
+// the cell is published by a release store of its sequence.
+template <class T>
+class MpmcQueue {
+public:
+  // capacity is rounded up to a power of 2
+  explicit MpmcQueue(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) {
+      size *= 2;
+    }
+    _cells.reset(new cell[size]);
+    _mask = size - 1;
+    for (size_t i = 0; i < size; ++i) {
+      _cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+    _tail.store(0, std::memory_order_relaxed);
+    _head.store(0, std::memory_order_relaxed);
+  }
+  MpmcQueue(const MpmcQueue&) = delete;
+  MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+  // false if full, x is left untouched then
+  bool try_push(T&& x) {
+    size_t pos = _tail.load(std::memory_order_relaxed);
+    for (;;) {
+      cell& c = _cells[pos & _mask];
+      const size_t seq = c.seq.load(std::memory_order_acquire);
+      const intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+      if (diff == 0) {
+        if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          c.data = std::move(x);
+          c.seq.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = _tail.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // false if empty
+  bool try_pop(T& x) {
+    size_t pos = _head.load(std::memory_order_relaxed);
+    for (;;) {
+      cell& c = _cells[pos & _mask];
+      const size_t seq = c.seq.load(std::memory_order_acquire);
+      const intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+      if (diff == 0) {
+        if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          x = std::move(c.data);
+          c.seq.store(pos + _mask + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = _head.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // approximate while other threads push or pop
+  size_t size() const {
+    const size_t head = _head.load(std::memory_order_relaxed);
+    const size_t tail = _tail.load(std::memory_order_relaxed);
+    return tail > head ? tail - head : 0;
+  }
+  size_t capacity() const { return _mask + 1; }
+
+private:
+  struct cell {
+    std::atomic<size_t> seq;
+    T data;
+  };
+
+  std::unique_ptr<cell[]> _cells;
+  size_t _mask;
+  // producers and consumers on separate cache lines
+  alignas(64) std::atomic<size_t> _tail;
+  alignas(64) std::atomic<size_t> _head;
+};
+
+} // namespace simple_rsa
+
+#endif // _MPMC_QUEUE_H__
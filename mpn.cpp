@@ -0,0 +1,507 @@
+#include <atomic>
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "mpn.h"
+
+namespace simple_rsa {
+
+namespace mpn {
+
+namespace {
+
+#if defined(__SIZEOF_INT128__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define MPN_WORDS 1
+
+// two uint32 limbs read as one uint64, the limb arrays are only 4 bytes
+// aligned and are accessed as uint32 elsewhere
+typedef uint64_t __attribute__((may_alias, aligned(4))) word;
+
+// a * b = *hi * 2^64 + return value
+inline uint64_t mul_wide(uint64_t a, uint64_t b, uint64_t *hi) {
+#ifdef __aarch64__
+  uint64_t h;
+  __asm__("umulh %0, %1, %2" : "=r"(h) : "r"(a), "r"(b));
+  *hi = h;
+  return a * b;
+#else
+  const unsigned __int128 t = (unsigned __int128)a * b;
+  *hi = t >> 64;
+  return (uint64_t)t;
+#endif
+}
+
+uint64_t mul_1_generic(word *rp, const word *ap, size_t n, uint64_t b) {
+  uint64_t c = 0;
+  for (size_t i = 0; i < n; ++i) {
+    uint64_t hi;
+    uint64_t lo = mul_wide(ap[i], b, &hi);
+    lo += c;
+    hi += lo < c;
+    rp[i] = lo;
+    c = hi;
+  }
+  return c;
+}
+
+uint64_t addmul_1_generic(word *rp, const word *ap, size_t n, uint64_t b) {
+  uint64_t c = 0;
+  for (size_t i = 0; i < n; ++i) {
+    uint64_t hi;
+    uint64_t lo = mul_wide(ap[i], b, &hi);
+    lo += c;
+    hi += lo < c;
+    const uint64_t r = rp[i];
+    lo += r;
+    hi += lo < r;
+    rp[i] = lo;
+    c = hi;
+  }
+  return c;
+}
+
+#ifdef __x86_64__
+// BMI2 mulx leaves the flags alone, so the high halves are added on the
+// CF chain (adcx) and rp on the OF chain (adox) without saving carries.
+// n % 4 single steps come first, then four words per trip; mov, lea and
+// jrcxz keep the loops from touching either flag.
+uint64_t mul_1_adx(word *rp, const word *ap, size_t n, uint64_t b) {
+  uint64_t c, lo, hi, zero;
+  size_t n1 = n % 4;
+  __asm__ volatile(
+      "xor %k[zero], %k[zero]\n\t"
+      "xor %k[c], %k[c]\n"
+      "1:\n\t"
+      "jrcxz 2f\n\t"
+      "mulx (%[ap]), %[lo], %[hi]\n\t"
+      "adcx %[c], %[lo]\n\t"
+      "mov %[lo], (%[rp])\n\t"
+      "mov %[hi], %[c]\n\t"
+      "lea 8(%[ap]), %[ap]\n\t"
+      "lea 8(%[rp]), %[rp]\n\t"
+      "lea -1(%%rcx), %%rcx\n\t"
+      "jmp 1b\n"
+      "2:\n\t"
+      "mov %[n4], %%rcx\n"
+      "3:\n\t"
+      "jrcxz 4f\n\t"
+      "mulx (%[ap]), %[lo], %[hi]\n\t"
+      "adcx %[c], %[lo]\n\t"
+      "mov %[lo], (%[rp])\n\t"
+      "mulx 8(%[ap]), %[lo], %[c]\n\t"
+      "adcx %[hi], %[lo]\n\t"
+      "mov %[lo], 8(%[rp])\n\t"
+      "mulx 16(%[ap]), %[lo], %[hi]\n\t"
+      "adcx %[c], %[lo]\n\t"
+      "mov %[lo], 16(%[rp])\n\t"
+      "mulx 24(%[ap]), %[lo], %[c]\n\t"
+      "adcx %[hi], %[lo]\n\t"
+      "mov %[lo], 24(%[rp])\n\t"
+      "lea 32(%[ap]), %[ap]\n\t"
+      "lea 32(%[rp]), %[rp]\n\t"
+      "lea -1(%%rcx), %%rcx\n\t"
+      "jmp 3b\n"
+      "4:\n\t"
+      "adcx %[zero], %[c]\n\t"
+      : [c] "=&r"(c), [lo] "=&r"(lo), [hi] "=&r"(hi), [zero] "=&r"(zero),
+        [rp] "+r"(rp), [ap] "+r"(ap), "+c"(n1)
+      : "d"(b), [n4] "r"(n / 4)
+      : "cc", "memory");
+  return c;
+}
+
+uint64_t addmul_1_adx(word *rp, const word *ap, size_t n, uint64_t b) {
+  uint64_t c, lo, hi, zero;
+  size_t n1 = n % 4;
+  __asm__ volatile(
+      "xor %k[zero], %k[zero]\n\t"
+      "xor %k[c], %k[c]\n"
+      "1:\n\t"
+      "jrcxz 2f\n\t"
+      "mulx (%[ap]), %[lo], %[hi]\n\t"
+      "adcx %[c], %[lo]\n\t"
+      "adox (%[rp]), %[lo]\n\t"
+      "mov %[lo], (%[rp])\n\t"
+      "mov %[hi], %[c]\n\t"
+      "lea 8(%[ap]), %[ap]\n\t"
+      "lea 8(%[rp]), %[rp]\n\t"
+      "lea -1(%%rcx), %%rcx\n\t"
+      "jmp 1b\n"
+      "2:\n\t"
+      "mov %[n4], %%rcx\n"
+      "3:\n\t"
+      "jrcxz 4f\n\t"
+      "mulx (%[ap]), %[lo], %[hi]\n\t"
+      "adcx %[c], %[lo]\n\t"
+      "adox (%[rp]), %[lo]\n\t"
+      "mov %[lo], (%[rp])\n\t"
+      "mulx 8(%[ap]), %[lo], %[c]\n\t"
+      "adcx %[hi], %[lo]\n\t"
+      "adox 8(%[rp]), %[lo]\n\t"
+      "mov %[lo], 8(%[rp])\n\t"
+      "mulx 16(%[ap]), %[lo], %[hi]\n\t"
+      "adcx %[c], %[lo]\n\t"
+      "adox 16(%[rp]), %[lo]\n\t"
+      "mov %[lo], 16(%[rp])\n\t"
+      "mulx 24(%[ap]), %[lo], %[c]\n\t"
+      "adcx %[hi], %[lo]\n\t"
+      "adox 24(%[rp]), %[lo]\n\t"
+      "mov %[lo], 24(%[rp])\n\t"
+      "lea 32(%[ap]), %[ap]\n\t"
+      "lea 32(%[rp]), %[rp]\n\t"
+      "lea -1(%%rcx), %%rcx\n\t"
+      "jmp 3b\n"
+      "4:\n\t"
+      "adcx %[zero], %[c]\n\t"
+      "adox %[zero], %[c]\n\t"
+      : [c] "=&r"(c), [lo] "=&r"(lo), [hi] "=&r"(hi), [zero] "=&r"(zero),
+        [rp] "+r"(rp), [ap] "+r"(ap), "+c"(n1)
+      : "d"(b), [n4] "r"(n / 4)
+      : "cc", "memory");
+  return c;
+}
+#endif
+
+struct word_kernels {
+  uint64_t (*mul_1)(word *rp, const word *ap, size_t n, uint64_t b);
+  uint64_t (*addmul_1)(word *rp, const word *ap, size_t n, uint64_t b);
+};
+
+const word_kernels GENERIC = {mul_1_generic, addmul_1_generic};
+#ifdef __x86_64__
+const word_kernels ADX = {mul_1_adx, addmul_1_adx};
+#endif
+
+bool supported(kernel_set k) {
+#ifdef __x86_64__
+  if (k == KERNELS_ADX) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("bmi2") && __builtin_cpu_supports("adx");
+  }
+#endif
+  return k == KERNELS_GENERIC;
+}
+
+kernel_set best() {
+  return supported(KERNELS_ADX) ? KERNELS_ADX : KERNELS_GENERIC;
+}
+
+const word_kernels* table(kernel_set k) {
+#ifdef __x86_64__
+  if (k == KERNELS_ADX) {
+    return &ADX;
+  }
+#endif
+  return &GENERIC;
+}
+
+// the first call through RESOLVE picks the kernels for the cpu. active
+// starts out constant initialized, so static initializers in other
+// translation units may multiply before this one's dynamic ones ran
+uint64_t mul_1_resolve(word *rp, const word *ap, size_t n, uint64_t b);
+uint64_t addmul_1_resolve(word *rp, const word *ap, size_t n, uint64_t b);
+const word_kernels RESOLVE = {mul_1_resolve, addmul_1_resolve};
+
+std::atomic<const word_kernels*> active{&RESOLVE};
+
+const word_kernels* kernel() {
+  return active.load(std::memory_order_relaxed);
+}
+
+// the kernels in use, picked now if nothing is yet. use_kernels may
+// have won the race, then its choice stays
+const word_kernels* resolve() {
+  const word_kernels *k = &RESOLVE;
+  active.compare_exchange_strong(k, table(best()), std::memory_order_relaxed);
+  return kernel();
+}
+
+uint64_t mul_1_resolve(word *rp, const word *ap, size_t n, uint64_t b) {
+  return resolve()->mul_1(rp, ap, n, b);
+}
+
+uint64_t addmul_1_resolve(word *rp, const word *ap, size_t n, uint64_t b) {
+  return resolve()->addmul_1(rp, ap, n, b);
+}
+
+// rp[0..n) += ap[0..n) * b for any n, returns the carry below 2^64,
+// which belongs in rp[n] and rp[n + 1]
+uint64_t addmul_w(uint32_t *rp, const uint32_t *ap, size_t n, uint64_t b) {
+  uint64_t c = kernel()->addmul_1((word*)rp, (const word*)ap, n / 2, b);
+  if (n % 2 != 0) {
+    // < 2^96, the high part fits in 64 bits
+    const unsigned __int128 t = (unsigned __int128)ap[n - 1] * b + rp[n - 1] + c;
+    rp[n - 1] = (uint32_t)t;
+    c = (uint64_t)(t >> 32);
+  }
+  return c;
+}
+
+#else
+// 32 bit limbs only
+bool supported(kernel_set k) {
+  return k == KERNELS_GENERIC;
+}
+#endif
+
+} // namespace
+
+kernel_set kernels() {
+#if defined(MPN_WORDS) && defined(__x86_64__)
+  return resolve() == &ADX ? KERNELS_ADX : KERNELS_GENERIC;
+#else
+  return KERNELS_GENERIC;
+#endif
+}
+
+bool use_kernels(kernel_set k) {
+  if (!supported(k)) {
+    return false;
+  }
+#ifdef MPN_WORDS
+  active.store(table(k), std::memory_order_relaxed);
+#endif
+  return true;
+}
+
+uint32_t mul_1(uint32_t *rp, const uint32_t *ap, size_t n, uint32_t b) {
+  uint64_t carry = 0;
+#ifdef MPN_WORDS
+  // the carry of a 64 x 32 bit row is below 2^32
+  carry = kernel()->mul_1((word*)rp, (const word*)ap, n / 2, b);
+  for (size_t i = n & ~(size_t)1; i < n; ++i) {
+#else
+  for (size_t i = 0; i < n; ++i) {
+#endif
+    carry += (uint64_t)ap[i] * b;
+    rp[i] = (uint32_t)carry;
+    carry >>= 32;
+  }
+  return carry;
+}
+
+uint32_t addmul_1(uint32_t *rp, const uint32_t *ap, size_t n, uint32_t b) {
+  uint64_t carry = 0;
+#ifdef MPN_WORDS
+  carry = kernel()->addmul_1((word*)rp, (const word*)ap, n / 2, b);
+  for (size_t i = n & ~(size_t)1; i < n; ++i) {
+#else
+  for (size_t i = 0; i < n; ++i) {
+#endif
+    // (2^32 - 1)^2 + 2 * (2^32 - 1) < 2^64
+    carry += (uint64_t)ap[i] * b + rp[i];
+    rp[i] = (uint32_t)carry;
+    carry >>= 32;
+  }
+  return carry;
+}
+
+void mul(uint32_t *rp, const uint32_t *ap, size_t an, const uint32_t *bp, size_t bn) {
+  std::memset(rp, 0, (an + bn) * sizeof(uint32_t));
+  size_t j = 0;
+#ifdef MPN_WORDS
+  // rows of two uint32 of b, the carry of a row lands on uint32 that
+  // no earlier row has written
+  for (; j + 2 <= bn; j += 2) {
+    const uint64_t c = addmul_w(rp + j, ap, an, bp[j] | (uint64_t)bp[j + 1] << 32);
+    std::memcpy(rp + j + an, &c, sizeof(c));
+  }
+#endif
+  for (; j < bn; ++j) {
+    rp[j + an] = addmul_1(rp + j, ap, an, bp[j]);
+  }
+}
+
+uint32_t submul_1(uint32_t *rp, const uint32_t *ap, size_t n, uint32_t b) {
+  uint64_t carry = 0;
+  for (size_t i = 0; i < n; ++i) {
+    carry += (uint64_t)ap[i] * b;
+    const uint32_t lo = (uint32_t)carry;
+    carry >>= 32;
+    carry += rp[i] < lo;
+    rp[i] -= lo;
+  }
+  return carry;
+}
+
+uint64_t add2mul_1(uint32_t *rp, const uint32_t *ap, uint32_t b,
+                   const uint32_t *cp, uint32_t d, size_t n) {
+  uint64_t c1 = 0, c2 = 0;
+  for (size_t i = 0; i < n; ++i) {
+    c1 += (uint64_t)ap[i] * b + rp[i];
+    c2 += (uint64_t)cp[i] * d + (uint32_t)c1;
+    rp[i] = (uint32_t)c2;
+    c1 >>= 32;
+    c2 >>= 32;
+  }
+  return c1 + c2;
+}
+
+uint32_t mod_1(const uint32_t *ap, size_t n, uint32_t d, uint32_t v) {
+  // "improved division by invariant integers", algorithm 4, r < d
+  // keeps every step a 2-by-1 division with u1 < d
+  uint32_t r = 0;
+  for (size_t i = n; i-- > 0;) {
+    const uint64_t u = ((uint64_t)r << 32) | ap[i];
+    const uint64_t q = (uint64_t)v * r + u;
+    const uint32_t q0 = (uint32_t)q;
+    r = ap[i] - ((uint32_t)(q >> 32) + 1) * d;
+    if (r > q0) {
+      r += d;
+    }
+    if (r >= d) {
+      r -= d;
+    }
+  }
+  return r;
+}
+
+uint32_t add_1(uint32_t *rp, size_t n, uint32_t c) {
+  for (size_t i = 0; i < n && c != 0; ++i) {
+    rp[i] += c;
+    c = rp[i] < c;
+  }
+  return c;
+}
+
+uint32_t sub_1(uint32_t *rp, size_t n, uint32_t c) {
+  for (size_t i = 0; i < n && c != 0; ++i) {
+    const uint32_t x = rp[i];
+    rp[i] = x - c;
+    c = x < c;
+  }
+  return c;
+}
+
+uint32_t add_n(uint32_t *rp, const uint32_t *ap, const uint32_t *bp, size_t n) {
+  uint64_t carry = 0;
+  for (size_t i = 0; i < n; ++i) {
+    carry += (uint64_t)ap[i] + bp[i];
+    rp[i] = (uint32_t)carry;
+    carry >>= 32;
+  }
+  return carry;
+}
+
+uint32_t sub_n(uint32_t *rp, const uint32_t *ap, const uint32_t *bp, size_t n) {
+  uint32_t borrow = 0;
+  for (size_t i = 0; i < n; ++i) {
+    const uint64_t t = (uint64_t)ap[i] - bp[i] - borrow;
+    rp[i] = (uint32_t)t;
+    borrow = (uint32_t)(t >> 63);
+  }
+  return borrow;
+}
+
+int cmp(const uint32_t *ap, const uint32_t *bp, size_t n) {
+  while (n-- > 0) {
+    if (ap[n] != bp[n]) {
+      return ap[n] < bp[n] ? -1 : 1;
+    }
+  }
+  return 0;
+}
+
+uint32_t lshift(uint32_t *rp, const uint32_t *ap, size_t n, unsigned s) {
+  if (s == 0) {
+    std::memmove(rp, ap, n * sizeof(uint32_t));
+    return 0;
+  }
+  const uint32_t out = ap[n - 1] >> (32 - s);
+  size_t i = n - 1;
+#ifdef __SSE2__
+  // 4 uint32 at a time from the top down, both loads of a block come
+  // before its store, so rp >= ap may overlap
+  const __m128i sl = _mm_cvtsi32_si128(s), sr = _mm_cvtsi32_si128(32 - s);
+  for (; i >= 4; i -= 4) {
+    const __m128i x = _mm_loadu_si128((const __m128i*)(ap + i - 3));
+    const __m128i y = _mm_loadu_si128((const __m128i*)(ap + i - 4));
+    _mm_storeu_si128((__m128i*)(rp + i - 3), _mm_or_si128(_mm_sll_epi32(x, sl), _mm_srl_epi32(y, sr)));
+  }
+#endif
+  for (; i > 0; --i) {
+    rp[i] = (ap[i] << s) | (ap[i - 1] >> (32 - s));
+  }
+  rp[0] = ap[0] << s;
+  return out;
+}
+
+uint32_t rshift(uint32_t *rp, const uint32_t *ap, size_t n, unsigned s) {
+  if (s == 0) {
+    std::memmove(rp, ap, n * sizeof(uint32_t));
+    return 0;
+  }
+  const uint32_t out = ap[0] << (32 - s);
+  size_t i = 0;
+#ifdef __SSE2__
+  // 4 uint32 at a time from the bottom up, rp <= ap may overlap
+  const __m128i sr = _mm_cvtsi32_si128(s), sl = _mm_cvtsi32_si128(32 - s);
+  for (; i + 4 < n; i += 4) {
+    const __m128i x = _mm_loadu_si128((const __m128i*)(ap + i));
+    const __m128i y = _mm_loadu_si128((const __m128i*)(ap + i + 1));
+    _mm_storeu_si128((__m128i*)(rp + i), _mm_or_si128(_mm_srl_epi32(x, sr), _mm_sll_epi32(y, sl)));
+  }
+#endif
+  for (; i + 1 < n; ++i) {
+    rp[i] = (ap[i] >> s) | (ap[i + 1] << (32 - s));
+  }
+  rp[n - 1] = ap[n - 1] >> s;
+  return out;
+}
+
+void mont_mul(uint32_t *rp, const uint32_t *ap, const uint32_t *bp,
+              const uint32_t *np, size_t n, uint32_t m, uint32_t *tp) {
+#ifdef MPN_WORDS
+  if (n % 2 == 0) {
+    // the same R = 2^(32n) with 64 bit words, every row is an a * b[i]
+    // pass and an n * q pass of the word kernel
+    const size_t w = n / 2;
+    const word *a = (const word*)ap, *b = (const word*)bp, *nw = (const word*)np;
+    word *tw = (word*)tp;
+    // one newton step takes -m = n^(-1) mod 2^32 to 2^64
+    const uint64_t n0 = nw[0];
+    uint64_t x = (uint32_t)-m;
+    x *= 2 - n0 * x;
+    const uint64_t m64 = -x;
+    for (size_t i = 0; i <= w; ++i) {
+      tw[i] = 0;
+    }
+    for (size_t i = 0; i < w; ++i) {
+      word *t = tw + i;
+      const uint64_t c1 = kernel()->addmul_1(t, a, w, b[i]);
+      const uint64_t q = t[0] * m64;
+      const uint64_t c2 = kernel()->addmul_1(t, nw, w, q);
+      uint64_t top = t[w] + c1;
+      uint64_t hi = top < c1;
+      top += c2;
+      hi += top < c2;
+      t[w] = top;
+      t[w + 1] = hi;
+    }
+  } else
+#endif
+  {
+    // t lives in tp[i..i+n] at step i, the low uint32 that becomes zero
+    // is left behind instead of shifting t down. t < 2 * np throughout
+    std::memset(tp, 0, (n + 1) * sizeof(uint32_t));
+    for (size_t i = 0; i < n; ++i) {
+      uint32_t *t = tp + i;
+      const uint32_t q = (ap[0] * bp[i] + t[0]) * m;
+      const uint64_t c = add2mul_1(t, np, q, ap, bp[i], n) + t[n];
+      t[n] = (uint32_t)c;
+      t[n + 1] = (uint32_t)(c >> 32);
+    }
+  }
+  const uint32_t *t = tp + n;
+  if (t[n] != 0 || cmp(t, np, n) >= 0) {
+    sub_n(rp, t, np, n);
+  } else {
+    std::memcpy(rp, t, n * sizeof(uint32_t));
+  }
+}
+
+} // namespace mpn
+
+} // namespace simple_rsa
@@ -0,0 +1,89 @@
+#ifndef _MPN_H__
+#define _MPN_H__ 1
+
+#include <cstddef>
+#include <cstdint>
+
+namespace simple_rsa {
+
+// kernels on little-endian uint32 limb arrays, the building blocks of
+// BigUint arithmetic. rp may be equal to ap, but must not overlap it
+// otherwise.
+//
+// where the compiler has 128 bit integers on a little-endian target,
+// mul_1, addmul_1, mul and mont_mul run on pairs of uint32 as 64 bit
+// words, with the word kernels picked at startup from the cpu.
+namespace mpn {
+
+using std::size_t;
+using std::uint32_t;
+using std::uint64_t;
+
+enum kernel_set {
+  // portable C++, mul/umulh pairs on aarch64
+  KERNELS_GENERIC,
+  // x86-64 BMI2 mulx with ADX adcx/adox carry chains
+  KERNELS_ADX,
+};
+
+// the word kernels in use
+kernel_set kernels();
+// for tests and benchmarks, safe to call while other threads multiply,
+// they switch on their next kernel call. false if the cpu or the build
+// can not run k
+bool use_kernels(kernel_set k);
+
+// rp[0..n) = ap[0..n) * b, returns the high limb
+uint32_t mul_1(uint32_t *rp, const uint32_t *ap, size_t n, uint32_t b);
+
+// rp[0..n) += ap[0..n) * b, returns the carry limb
+uint32_t addmul_1(uint32_t *rp, const uint32_t *ap, size_t n, uint32_t b);
+
+// rp[0..an+bn) = ap[0..an) * bp[0..bn), rp overlaps neither
+void mul(uint32_t *rp, const uint32_t *ap, size_t an, const uint32_t *bp, size_t bn);
+
+// rp[0..n) -= ap[0..n) * b, returns the borrow limb
+uint32_t submul_1(uint32_t *rp, const uint32_t *ap, size_t n, uint32_t b);
+
+// rp[0..n) += ap[0..n) * b + cp[0..n) * d in one pass with two carry
+// chains, returns the carry, less than 2^33
+uint64_t add2mul_1(uint32_t *rp, const uint32_t *ap, uint32_t b,
+                   const uint32_t *cp, uint32_t d, size_t n);
+
+// rp[0..n) += c, returns the carry out
+uint32_t add_1(uint32_t *rp, size_t n, uint32_t c);
+
+// rp[0..n) -= c, returns the borrow out
+uint32_t sub_1(uint32_t *rp, size_t n, uint32_t c);
+
+// rp[0..n) = ap[0..n) + bp[0..n), returns the carry out
+uint32_t add_n(uint32_t *rp, const uint32_t *ap, const uint32_t *bp, size_t n);
+
+// rp[0..n) = ap[0..n) - bp[0..n), returns the borrow out
+uint32_t sub_n(uint32_t *rp, const uint32_t *ap, const uint32_t *bp, size_t n);
+
+// sign of ap[0..n) - bp[0..n)
+int cmp(const uint32_t *ap, const uint32_t *bp, size_t n);
+
+// rp[0..n) = ap[0..n) << s, n > 0, s < 32, returns the bits shifted out.
+// rp >= ap may overlap, e.g. to shift by whole uint32 at the same time
+uint32_t lshift(uint32_t *rp, const uint32_t *ap, size_t n, unsigned s);
+
+// rp[0..n) = ap[0..n) >> s, n > 0, s < 32, returns the bits shifted out in
+// the high end of the result. rp <= ap may overlap
+uint32_t rshift(uint32_t *rp, const uint32_t *ap, size_t n, unsigned s);
+
+// ap[0..n) mod(d) for a d with the top bit set, v = (2^64 - 1) / d - 2^32.
+// one möller-granlund 2-by-1 step per limb, multiplications only
+uint32_t mod_1(const uint32_t *ap, size_t n, uint32_t d, uint32_t v);
+
+// rp[0..n) = ap * bp * r^(-n) mod(np), r = 2^32, m = -np[0]^(-1) mod r,
+// ap < np, bp < r^n. tp is scratch of 2n + 2 uint32, rp may be ap or bp
+void mont_mul(uint32_t *rp, const uint32_t *ap, const uint32_t *bp,
+              const uint32_t *np, size_t n, uint32_t m, uint32_t *tp);
+
+} // namespace mpn
+
+} // namespace simple_rsa
+
+#endif // _MPN_H__
@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "drbg.h"
+#include "pkcs1.h"
+#include "sha256.h"
+
+namespace simple_rsa {
+
+namespace {
+
+// DER of DigestInfo with the SHA-256 algorithm, the digest follows
+const uint8_t SHA256_PREFIX[] = {
+  0x30, 0x31, 0x30, 0x0d, 0x06, 0x09, 0x60, 0x86, 0x48, 0x01,
+  0x65, 0x03, 0x04, 0x02, 0x01, 0x05, 0x00, 0x04, 0x20};
+
+size_t block_size(const rsa& r) {
+  return (r.key().bits() + 7) / 8;
+}
+
+// EMSA-PKCS1-v1_5: 00 01 ff .. ff 00 DigestInfo
+std::vector<uint8_t> encode_signature(const uint8_t *m, size_t n, size_t k) {
+  const Sha256::digest h = Sha256::hash(m, n);
+  const size_t t = sizeof(SHA256_PREFIX) + h.size();
+  if (k < t + 11) {
+    throw std::invalid_argument("simple_rsa: key too short for a SHA-256 signature");
+  }
+  std::vector<uint8_t> em(k, 0xff);
+  em[0] = 0;
+  em[1] = 1;
+  em[k - t - 1] = 0;
+  std::copy(SHA256_PREFIX, SHA256_PREFIX + sizeof(SHA256_PREFIX), em.end() - t);
+  std::copy(h.begin(), h.end(), em.end() - h.size());
+  return em;
+}
+
+} // namespace
+
+std::vector<uint8_t> pkcs1_encrypt(const rsa& r, const uint8_t *m, size_t n) {
+  const size_t k = block_size(r);
+  if (n + 11 > k) {
+    throw std::invalid_argument("simple_rsa: message too long");
+  }
+  // 00 02 PS 00 M, PS at least 8 nonzero random bytes
+  std::vector<uint8_t> em(k);
+  em[0] = 0;
+  em[1] = 2;
+  Drbg& drbg = Drbg::local();
+  for (size_t i = 2; i < k - n - 1; ++i) {
+    em[i] = 1 + drbg.uniform(255);
+  }
+  em[k - n - 1] = 0;
+  std::copy(m, m + n, em.end() - n);
+  return r.encrypt(BigUint::from_bytes(em.data(), k)).to_bytes(k);
+}
+
+std::vector<uint8_t> pkcs1_decrypt(const rsa& r, const uint8_t *c, size_t n) {
+  const size_t k = block_size(r);
+  const BigUint x = BigUint::from_bytes(c, n);
+  if (n != k || x >= r.key().n) {
+    throw std::runtime_error("simple_rsa: decryption error");
+  }
+  const std::vector<uint8_t> em = r.decrypt(x).to_bytes(k);
+  // one message for every failure, without an early exit
+  size_t zero = 0;
+  bool ok = em[0] == 0 && em[1] == 2;
+  for (size_t i = 2; i < k; ++i) {
+    if (em[i] == 0 && zero == 0) {
+      zero = i;
+    }
+  }
+  ok = ok && zero >= 10;
+  if (!ok) {
+    throw std::runtime_error("simple_rsa: decryption error");
+  }
+  return std::vector<uint8_t>(em.begin() + zero + 1, em.end());
+}
+
+std::vector<uint8_t> pkcs1_sign(const rsa& r, const uint8_t *m, size_t n) {
+  const size_t k = block_size(r);
+  const std::vector<uint8_t> em = encode_signature(m, n, k);
+  return r.sign(BigUint::from_bytes(em.data(), k)).to_bytes(k);
+}
+
+bool pkcs1_verify(const rsa& r, const uint8_t *m, size_t n, const uint8_t *s, size_t sn) {
+  const size_t k = block_size(r);
+  if (sn != k) {
+    return false;
+  }
+  const BigUint x = BigUint::from_bytes(s, sn);
+  if (x >= r.key().n) {
+    return false;
+  }
+  return r.verify(x).to_bytes(k) == encode_signature(m, n, k);
+}
+
+} // namespace simple_rsa
@@ -0,0 +1,24 @@
+#ifndef _PKCS1_H__
+#define _PKCS1_H__ 1
+
+#include <vector>
+
+#include "rsa.h"
+
+namespace simple_rsa {
+
+// PKCS#1 v1.5 (RFC 8017) on top of the raw operations of rsa, every
+// block is k bytes, the byte length of n.
+
+// RSAES-PKCS1-v1_5, the message is at most k - 11 bytes
+std::vector<uint8_t> pkcs1_encrypt(const rsa& r, const uint8_t *m, size_t n);
+// throws std::runtime_error if c is not a valid encryption
+std::vector<uint8_t> pkcs1_decrypt(const rsa& r, const uint8_t *c, size_t n);
+
+// RSASSA-PKCS1-v1_5 with SHA-256
+std::vector<uint8_t> pkcs1_sign(const rsa& r, const uint8_t *m, size_t n);
+bool pkcs1_verify(const rsa& r, const uint8_t *m, size_t n, const uint8_t *s, size_t sn);
+
+} // namespace simple_rsa
+
+#endif // _PKCS1_H__
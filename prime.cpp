@@ -1,16 +1,30 @@
+#include <algorithm>
+#include <cassert>
+#include <cstring>
 #include <vector>
-#include "biguint.h"
+#include "montgomery.h"
+#include "mpn.h"
+#include "prime.h"
+#include "scratch.h"
 
 namespace simple_rsa {
 
+void prime_remainders(const BigUint& b, uint32_t *r) {
+  for (int g = 0; g < PRIME_GROUPS_SIZE; ++g) {
+    const prime_group& group = PRIME_GROUPS[g];
+    const uint32_t x = mpn::mod_1(b.data(), b.size(), group.d, group.v);
+    for (int i = group.first; i < group.first + group.count; ++i) {
+      r[i] = prime_mod(x, i);
+    }
+  }
+}
+
 void primer_numbers_test(BigUint& b) {
   if (b.is_even()) {
     b += 1;
   }
   std::vector<uint32_t> remainders(PRIME_NUMBERS_SIZE);
-  for (int i = 0; i < PRIME_NUMBERS_SIZE; ++i) {
-    remainders[i] = b % PRIME_NUMBERS[i];
-  }
+  prime_remainders(b, remainders.data());
   bool ok = true;
   do {
     ok = true;
@@ -22,11 +36,218 @@ void primer_numbers_test(BigUint& b) {
     if (!ok) {
       b += 2;
       for (int i = 0; i < PRIME_NUMBERS_SIZE; ++i) {
-        remainders[i] = (remainders[i] + 2) % PRIME_NUMBERS[i];
+        remainders[i] += 2;
+        if (remainders[i] >= PRIME_NUMBERS[i]) {
+          remainders[i] -= PRIME_NUMBERS[i];
+        }
       }
       continue;
     }
   } while (!ok);
 }
 
+namespace {
+
+// rounds for an error probability below 2^-80 on random candidates
+int miller_rabin_rounds(int bits) {
+  return bits >= 1300 ?  2 :
+         bits >=  850 ?  3 :
+         bits >=  650 ?  4 :
+         bits >=  550 ?  5 :
+         bits >=  450 ?  6 :
+         bits >=  400 ?  7 :
+         bits >=  350 ?  8 :
+         bits >=  300 ?  9 :
+         bits >=  250 ? 12 :
+         bits >=  200 ? 15 :
+         bits >=  150 ? 18 : 27;
+}
+
+// b odd and > 3, b1 = b - 1
+bool miller_rabin(const Montgomery& mont, const BigUint& b, const BigUint& b1) {
+  // b - 1 = d * 2^s
+  int s = 1;
+  while (!b1.test_bit(s)) {
+    ++s;
+  }
+  const BigUint d = b1.right_shift(s);
+  const int bits = b.bits();
+  const int rounds = miller_rabin_rounds(bits);
+  // the rounds run in montgomery form on scratch memory, 1 and b - 1
+  // are compared in that form too
+  const Montgomery::exponent ed = Montgomery::recode(d);
+  const size_t n = mont.size();
+  Scratch::Scope scratch;
+  uint32_t *x = scratch.alloc(n);
+  uint32_t *one = scratch.alloc(n);
+  uint32_t *minus_one = scratch.alloc(n);
+  mont.to_mont(one, 1);
+  mont.to_mont(minus_one, b1);
+  BigUint a;
+  for (int i = 0; i < rounds; ++i) {
+    // 2 <= a < b - 1
+    a.random_bits(bits - 1);
+    mont.to_mont(x, a);
+    mont.pow(x, x, ed);
+    if (mpn::cmp(x, one, n) == 0 || mpn::cmp(x, minus_one, n) == 0) {
+      continue;
+    }
+    int j = 1;
+    for (; j < s; ++j) {
+      mont.mul(x, x, x);
+      if (mpn::cmp(x, minus_one, n) == 0) {
+        break;
+      }
+    }
+    if (j == s) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// 2^(b-1) == 1 mod(b). left to right over b - 1, a set bit doubles x
+// with a shift instead of multiplying, and there is no window table
+bool fermat_base2(const Montgomery& mont, const BigUint& b1) {
+  const size_t n = mont.size();
+  const uint32_t *np = mont.modulus().data();
+  Scratch::Scope scratch;
+  uint32_t *x = scratch.alloc(n);
+  uint32_t *one = scratch.alloc(n);
+  mont.to_mont(one, 1);
+  // the top bit of b - 1
+  mont.to_mont(x, 2);
+  for (int i = b1.bits() - 2; i >= 0; --i) {
+    mont.mul(x, x, x);
+    if (b1.test_bit(i)) {
+      // x < b, so 2x fits in one more bit and one subtraction reduces it
+      if (mpn::lshift(x, x, n, 1) != 0 || mpn::cmp(x, np, n) >= 0) {
+        mpn::sub_n(x, x, np, n);
+      }
+    }
+  }
+  return mpn::cmp(x, one, n) == 0;
+}
+
+// fermat then miller-rabin on a candidate that passed the sieve
+bool sieved_prime_test(const BigUint& b, prime_stats& stats) {
+  const Montgomery mont(b);
+  const BigUint b1 = b - 1;
+  if (!fermat_base2(mont, b1)) {
+    ++stats.fermat;
+    return false;
+  }
+  if (!miller_rabin(mont, b, b1)) {
+    ++stats.miller_rabin;
+    return false;
+  }
+  ++stats.primes;
+  return true;
+}
+
+} // namespace
+
+bool miller_rabin_test(const BigUint& b) {
+  if (b < 4) {
+    return b == 2 || b == 3;
+  }
+  if (b.is_even()) {
+    return false;
+  }
+  return miller_rabin(Montgomery(b), b, b - 1);
+}
+
+
+prime_stats& prime_stats::operator+=(const prime_stats& o) {
+  candidates += o.candidates;
+  sieve += o.sieve;
+  fermat += o.fermat;
+  miller_rabin += o.miller_rabin;
+  primes += o.primes;
+  return *this;
+}
+
+void prime_test(const BigUint *b, size_t n, bool *prime, prime_stats *stats) {
+  prime_stats local;
+  local.candidates = n;
+  // trial division first over the whole batch, most composites leave
+  // here on one of the first few primes
+  std::vector<size_t> survivors;
+  for (size_t i = 0; i < n; ++i) {
+    prime[i] = false;
+    if (b[i] <= PRIME_NUMBERS[PRIME_NUMBERS_SIZE - 1]) {
+      // too small for the sieve, 2 and the sieve primes themselves
+      if (miller_rabin_test(b[i])) {
+        prime[i] = true;
+        ++local.primes;
+      } else {
+        ++local.sieve;
+      }
+      continue;
+    }
+    bool composite = b[i].is_even();
+    for (int g = 0; g < PRIME_GROUPS_SIZE && !composite; ++g) {
+      const prime_group& group = PRIME_GROUPS[g];
+      const uint32_t x = mpn::mod_1(b[i].data(), b[i].size(), group.d, group.v);
+      for (int j = group.first; j < group.first + group.count && !composite; ++j) {
+        composite = prime_mod(x, j) == 0;
+      }
+    }
+    if (composite) {
+      ++local.sieve;
+    } else {
+      survivors.push_back(i);
+    }
+  }
+  for (size_t i : survivors) {
+    prime[i] = sieved_prime_test(b[i], local);
+  }
+  if (stats != nullptr) {
+    *stats += local;
+  }
+}
+
+BigUint next_prime(const BigUint& b, prime_stats *stats) {
+  assert(b > PRIME_NUMBERS[PRIME_NUMBERS_SIZE - 1]);
+  prime_stats local;
+  BigUint base = b.is_even() ? b + 1 : b;
+  // the candidates are base + 2j for j < window, about 4 times the
+  // expected gap between primes of the size
+  const uint32_t window = std::max(256, 2 * base.bits());
+  std::vector<uint32_t> remainders(PRIME_NUMBERS_SIZE);
+  prime_remainders(base, remainders.data());
+  std::vector<uint8_t> composite(window);
+  BigUint c;
+  for (;;) {
+    std::memset(composite.data(), 0, window);
+    for (int i = 0; i < PRIME_NUMBERS_SIZE; ++i) {
+      // base + 2j = 0 mod(p) for j = -r / 2, (p + 1) / 2 is 1 / 2 mod(p)
+      const uint32_t p = PRIME_NUMBERS[i];
+      uint32_t j = prime_mod((p - remainders[i]) * ((p + 1) / 2), i);
+      for (; j < window; j += p) {
+        composite[j] = 1;
+      }
+    }
+    for (uint32_t j = 0; j < window; ++j) {
+      ++local.candidates;
+      if (composite[j]) {
+        ++local.sieve;
+        continue;
+      }
+      c = base;
+      c += 2 * j;
+      if (sieved_prime_test(c, local)) {
+        if (stats != nullptr) {
+          *stats += local;
+        }
+        return c;
+      }
+    }
+    base += 2 * window;
+    for (int i = 0; i < PRIME_NUMBERS_SIZE; ++i) {
+      remainders[i] = prime_mod(remainders[i] + 2 * window, i);
+    }
+  }
+}
+
 } // namespace simple_rsa
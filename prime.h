@@ -0,0 +1,69 @@
+#ifndef _PRIME_H__
+#define _PRIME_H__ 1
+
+#include "biguint.h"
+
+namespace simple_rsa {
+
+// 2^64 / p + 1 for each of PRIME_NUMBERS
+extern const uint64_t *const PRIME_RECIPROCALS;
+
+// a mod(PRIME_NUMBERS[i]) by lemire's fastmod, two multiplications
+inline uint32_t prime_mod(uint32_t a, int i) {
+  const uint64_t low = PRIME_RECIPROCALS[i] * a;
+  const uint64_t p = PRIME_NUMBERS[i];
+  // (low * p) >> 64 without a 128 bit product
+  return ((low >> 32) * p + (((low & 0xffffffff) * p) >> 32)) >> 32;
+}
+
+// PRIME_NUMBERS[first, first + count) packed into one word: their
+// product shifted left until the top bit is set, v as in mpn::mod_1
+struct prime_group {
+  uint32_t d;
+  uint32_t v;
+  int first;
+  int count;
+};
+
+extern const prime_group *const PRIME_GROUPS;
+extern const int PRIME_GROUPS_SIZE;
+
+// r[i] = b mod(PRIME_NUMBERS[i]) for every prime, a pass over b per
+// group and no division instruction
+void prime_remainders(const BigUint& b, uint32_t *r);
+
+// candidates seen by a batch primality test and how many each stage
+// rejected, a stage only sees what the ones before it let through
+struct prime_stats {
+  uint64_t candidates = 0;
+  // a factor in PRIME_NUMBERS
+  uint64_t sieve = 0;
+  // 2^(b-1) != 1 mod(b)
+  uint64_t fermat = 0;
+  uint64_t miller_rabin = 0;
+  uint64_t primes = 0;
+
+  prime_stats& operator+=(const prime_stats& o);
+  // fraction of the candidates reaching a stage that it rejects
+  double sieve_rate() const { return _rate_(sieve, candidates); }
+  double fermat_rate() const { return _rate_(fermat, candidates - sieve); }
+  double miller_rabin_rate() const { return _rate_(miller_rabin, candidates - sieve - fermat); }
+
+private:
+  static double _rate_(uint64_t n, uint64_t of) { return of == 0 ? 0 : (double)n / of; }
+};
+
+// prime[i] = miller_rabin_test(b[i]) for n candidates, stage by stage:
+// trial division by PRIME_NUMBERS, a fermat test to base 2 that only
+// squares and doubles, then the miller-rabin rounds on what is left
+void prime_test(const BigUint *b, size_t n, bool *prime, prime_stats *stats = nullptr);
+
+// the smallest probable prime >= b, b > the largest of PRIME_NUMBERS.
+// a window of odd candidates is sieved at once from one set of
+// remainders, the survivors go through fermat and miller-rabin in order
+// and the search stops at the first prime
+BigUint next_prime(const BigUint& b, prime_stats *stats = nullptr);
+
+} // namespace simple_rsa
+
+#endif // _PRIME_H__
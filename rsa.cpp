@@ -0,0 +1,323 @@
+#include <algorithm>
+#include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <thread>
+#include <utility>
+
+#include "key_file.h"
+#include "prime.h"
+#include "rsa.h"
+
+namespace simple_rsa {
+
+namespace {
+
+// random prime with the two top bits set, p - 1 and e are relatively prime
+BigUint generate_prime(int bits, uint32_t e) {
+  BigUint p;
+  for (;;) {
+    p.random_bits(bits);
+    p.set_bit(bits - 2);
+    p = next_prime(p);
+    if (p.bits() == bits && (p - 1) % e != 0) {
+      return p;
+    }
+  }
+}
+
+// threads for the exponentiations of parallel private operations, one
+// per prime after the first, started on first use and kept. a caller
+// waiting for its results runs queued exponentiations itself, so many
+// callers at once do not queue up behind the few threads
+class crt_pool {
+public:
+  typedef std::packaged_task<BigUint()> task;
+
+  crt_pool() {
+    for (int i = 1; i < rsa::MAX_PRIMES; ++i) {
+      _threads.emplace_back(&crt_pool::_worker_, this);
+    }
+  }
+
+  ~crt_pool() {
+    {
+      std::lock_guard<std::mutex> guard(_lock);
+      _stop = true;
+    }
+    _wake.notify_all();
+    for (auto& t : _threads) {
+      t.join();
+    }
+  }
+
+  static crt_pool& instance() {
+    static crt_pool pool;
+    return pool;
+  }
+
+  std::future<BigUint> push(task t) {
+    std::future<BigUint> f = t.get_future();
+    {
+      std::lock_guard<std::mutex> guard(_lock);
+      _tasks.push_back(std::move(t));
+    }
+    _wake.notify_one();
+    return f;
+  }
+
+  // runs one queued task on the calling thread, false when there is none
+  bool run_one() {
+    task t;
+    {
+      std::lock_guard<std::mutex> guard(_lock);
+      if (_tasks.empty()) {
+        return false;
+      }
+      t = std::move(_tasks.front());
+      _tasks.pop_front();
+    }
+    t();
+    return true;
+  }
+
+private:
+  void _worker_() {
+    for (;;) {
+      task t;
+      {
+        std::unique_lock<std::mutex> lock(_lock);
+        _wake.wait(lock, [this] { return !_tasks.empty() || _stop; });
+        if (_tasks.empty()) {
+          return;
+        }
+        t = std::move(_tasks.front());
+        _tasks.pop_front();
+      }
+      t();
+    }
+  }
+
+  std::mutex _lock;
+  std::condition_variable _wake;
+  std::deque<task> _tasks;
+  bool _stop = false;
+  std::vector<std::thread> _threads;
+};
+
+} // namespace
+
+void rsa::keygen(int bits, uint32_t e, int primes) {
+  assert(primes >= 2 && primes <= MAX_PRIMES && bits >= 32 * primes);
+  assert(e >= 3 && e % 2 == 1 && miller_rabin_test(e));
+  // sizes in 64 bit units when n allows it, montgomery multiplication
+  // goes word by word only over an even number of limbs, e.g. 4096 bits
+  // in three primes are 1408 + 1344 + 1344 instead of 1366 + 2 * 1365
+  const int unit = bits % 64 == 0 && bits >= 64 * primes ? 64 : 1;
+  const int units = bits / unit;
+  std::vector<BigUint> r(primes);
+  BigUint n;
+  for (;;) {
+    // two primes with the top bits set always give a `bits` bits n,
+    // more may fall short
+    for (int i = 0; i < primes; ++i) {
+      r[i] = generate_prime((units / primes + (i < units % primes)) * unit, e);
+    }
+    std::sort(r.begin(), r.end(), [](const BigUint& a, const BigUint& b) { return a > b; });
+    if (std::adjacent_find(r.begin(), r.end()) != r.end()) {
+      continue;
+    }
+    n = r[0];
+    for (int i = 1; i < primes; ++i) {
+      n *= r[i];
+    }
+    if (n.bits() == bits) {
+      break;
+    }
+  }
+
+  rsa_key k;
+  k.n = std::move(n);
+  k.e = e;
+  k.p = r[0];
+  k.q = r[1];
+  BigUint phi = k.p - 1;
+  for (int i = 1; i < primes; ++i) {
+    phi *= r[i] - 1;
+  }
+  k.d = phi.mod_mul_inv(e);
+  k.dp = k.d % (k.p - 1);
+  k.dq = k.d % (k.q - 1);
+  k.qinv = k.p.mod_mul_inv(k.q);
+  BigUint product = k.p * k.q;
+  for (int i = 2; i < primes; ++i) {
+    rsa_prime o;
+    o.r = r[i];
+    o.d = k.d % (r[i] - 1);
+    o.t = r[i].mod_mul_inv(product % r[i]);
+    product *= r[i];
+    k.others.push_back(std::move(o));
+  }
+  _ctx = std::make_shared<rsa_context>(k);
+}
+
+
+rsa_context::rsa_context(const rsa_key& key):_key{key} {
+  _mont_n.reset(new Montgomery(key.n));
+  if (key.is_private()) {
+    _primes.resize(key.primes());
+    for (size_t i = 0; i < _primes.size(); ++i) {
+      _primes[i].mont.reset(new Montgomery(key.prime(i)));
+    }
+  }
+  _init_exponents_();
+}
+
+rsa_context::rsa_context(const KeyFile& file):_key{file.key()} {
+  _mont_n.reset(new Montgomery(file.montgomery(KEY_N)));
+  if (_key.is_private()) {
+    _primes.resize(_key.primes());
+    for (size_t i = 0; i < _primes.size(); ++i) {
+      _primes[i].mont.reset(new Montgomery(file.montgomery(key_prime_field(i))));
+    }
+  }
+  _init_exponents_();
+}
+
+void rsa_context::_init_exponents_() {
+  _e = Montgomery::recode(_key.e);
+  BigUint product = 1;
+  for (size_t i = 0; i < _primes.size(); ++i) {
+    _primes[i].d = Montgomery::recode(_key.prime_exponent(i));
+    if (i >= 2) {
+      _primes[i].product = product;
+    }
+    product *= _key.prime(i);
+  }
+}
+
+BigUint rsa_context::public_op(const BigUint& m) const {
+  return _mont_n->pow(m, _e);
+}
+
+BigUint rsa_context::private_op(const BigUint& c, bool parallel) const {
+  assert(_key.is_private());
+  std::vector<BigUint> m(_primes.size());
+  if (parallel) {
+    crt_pool& pool = crt_pool::instance();
+    std::vector<std::future<BigUint>> others;
+    others.reserve(_primes.size() - 1);
+    try {
+      for (size_t i = 1; i < _primes.size(); ++i) {
+        others.push_back(pool.push(crt_pool::task([this, &c, i]() { return _crt_pow_(c, i); })));
+      }
+      m[0] = _crt_pow_(c, 0);
+      while (pool.run_one()) {
+      }
+      for (size_t i = 1; i < _primes.size(); ++i) {
+        m[i] = others[i - 1].get();
+      }
+    } catch (...) {
+      // the queued tasks use c and this, they finish before we unwind
+      for (auto& f : others) {
+        if (f.valid()) {
+          f.wait();
+        }
+      }
+      throw;
+    }
+  } else {
+    for (size_t i = 0; i < _primes.size(); ++i) {
+      m[i] = _crt_pow_(c, i);
+    }
+  }
+  return _recombine_(m);
+}
+
+BigUint rsa_context::_recombine_(const std::vector<BigUint>& m) const {
+  // h = qinv * (m1 - m2) mod(p)
+  BigUint h = m[0] + _key.p - m[1] % _key.p;
+  h = h * _key.qinv % _key.p;
+  BigUint x = m[1] + h * _key.q;
+  // garner, RFC 8017 5.1.2: x is right mod(r_1 * .. * r_(i-1)) so far,
+  // h = t_i * (m_i - x) mod(r_i) lifts it to r_i too
+  for (size_t i = 2; i < m.size(); ++i) {
+    const rsa_prime& o = _key.others[i - 2];
+    h = m[i] + o.r - x % o.r;
+    h = h * o.t % o.r;
+    x += _primes[i].product * h;
+  }
+  return x;
+}
+
+rsa_context::blinding rsa_context::_new_blinding_() const {
+  blinding b;
+  BigUint r;
+  do {
+    r.random_bits(_key.bits() - 1);
+    b.vf = _key.n.mod_mul_inv(r);
+  } while (b.vf == 0);
+  b.vi = public_op(r);
+  b.uses = 0;
+  return b;
+}
+
+BigUint rsa_context::blinded_private_op(const BigUint& c, bool parallel) const {
+  BigUint m;
+  _blinded_private_op_(&c, &m, 1, parallel);
+  return m;
+}
+
+void rsa_context::blinded_private_op(const BigUint *c, BigUint *m, size_t n) const {
+  _blinded_private_op_(c, m, n, false);
+}
+
+void rsa_context::_blinded_private_op_(const BigUint *c, BigUint *m, size_t n, bool parallel) const {
+  blinding b;
+  {
+    std::lock_guard<std::mutex> guard(_blinding_lock);
+    if (!_blindings.empty()) {
+      b = std::move(_blindings.back());
+      _blindings.pop_back();
+    }
+  }
+  for (size_t i = 0; i < n; ++i) {
+    if (b.uses == 0 || b.uses >= BLINDING_USES) {
+      b = _new_blinding_();
+    }
+    // (c * r^e)^d * r^(-1) = c^d
+    m[i] = private_op(c[i] * b.vi % _key.n, parallel) * b.vf % _key.n;
+    // (r^2)^e and (r^2)^(-1) for the next call
+    b.vi = b.vi * b.vi % _key.n;
+    b.vf = b.vf * b.vf % _key.n;
+    ++b.uses;
+  }
+  {
+    std::lock_guard<std::mutex> guard(_blinding_lock);
+    _blindings.push_back(std::move(b));
+  }
+}
+
+size_t rsa_context::memory() const {
+  const BigUint* fields[] = {&_key.n, &_key.e, &_key.d, &_key.p, &_key.q,
+                             &_key.dp, &_key.dq, &_key.qinv};
+  size_t bytes = sizeof(*this);
+  for (auto f : fields) {
+    bytes += f->size() * sizeof(uint32_t);
+  }
+  for (const rsa_prime& o : _key.others) {
+    bytes += sizeof(o) + (o.r.size() + o.d.size() + o.t.size()) * sizeof(uint32_t);
+  }
+  auto montgomery = [](const Montgomery& m) {
+    return sizeof(Montgomery) +
+           (m.modulus().size() + m.r2().size() + m.one().size()) * sizeof(uint32_t);
+  };
+  bytes += montgomery(*_mont_n) + _e.digits.size();
+  for (const crt_prime& r : _primes) {
+    bytes += sizeof(r) + montgomery(*r.mont) + r.d.digits.size() + r.product.size() * sizeof(uint32_t);
+  }
+  return bytes;
+}
+
+} // namespace simple_rsa
@@ -1,20 +1,162 @@
 #ifndef _RSA_H__
 #define _RSA_H__ 1
 
+#include <memory>
+#include <mutex>
+#include <vector>
+
 #include <biguint.h>
+#include <montgomery.h>
 
 namespace simple_rsa {
 
+// RFC 8017 OtherPrimeInfo, the third and later primes of a multi-prime key
+struct rsa_prime {
+  BigUint r;
+  // d mod(r - 1)
+  BigUint d;
+  // (r_1 * .. * r_(i-1))^(-1) mod(r), r_1 = p and r_2 = q
+  BigUint t;
+};
+
+// PKCS#1 RSAPrivateKey fields, only n and e are set for a public key
+struct rsa_key {
+  BigUint n;
+  BigUint e;
+  BigUint d;
+  BigUint p;
+  BigUint q;
+  // d mod(p - 1), d mod(q - 1), q^(-1) mod(p)
+  BigUint dp;
+  BigUint dq;
+  BigUint qinv;
+  // empty for a two-prime key
+  std::vector<rsa_prime> others;
+
+  bool is_private() const { return d > 0; }
+  int bits() const { return n.bits(); }
+
+  // the primes are p, q and then others
+  size_t primes() const { return 2 + others.size(); }
+  const BigUint& prime(size_t i) const {
+    return i == 0 ? p : i == 1 ? q : others[i - 2].r;
+  }
+  // d mod(prime(i) - 1)
+  const BigUint& prime_exponent(size_t i) const {
+    return i == 0 ? dp : i == 1 ? dq : others[i - 2].d;
+  }
+};
+
+class KeyFile;
+
+// per-key precomputation: montgomery constants of n and every prime and
+// the recoded exponents, built once and shared by every operation on the key
+class rsa_context {
+public:
+  explicit rsa_context(const rsa_key& key);
+  // reuses the montgomery constants stored in the file
+  explicit rsa_context(const KeyFile& file);
+  rsa_context(const rsa_context&) = delete;
+  rsa_context& operator=(const rsa_context&) = delete;
+
+  const rsa_key& key() const { return _key; }
+
+  // m^e mod(n)
+  BigUint public_op(const BigUint& m) const;
+  // c^d mod(n) by CRT over all primes, needs a private key. with
+  // parallel the exponentiations mod(prime(1)) and on go to a shared
+  // pool of threads while the caller does the one mod(p)
+  BigUint private_op(const BigUint& c, bool parallel = false) const;
+  // private_op with base blinding, the time taken does not depend on c.
+  // blinding pairs (r^e, r^(-1)) are kept between calls and squared
+  // after each use, a fresh r is drawn every BLINDING_USES uses
+  BigUint blinded_private_op(const BigUint& c, bool parallel = false) const;
+  // m[i] = blinded_private_op(c[i]) for a batch on this key, one pair
+  // is taken from the pool and stepped through the whole batch
+  void blinded_private_op(const BigUint *c, BigUint *m, size_t n) const;
+
+  static const int BLINDING_USES = 32;
+
+  // approximate bytes held, for cache budgets
+  size_t memory() const;
+
+private:
+  struct blinding {
+    BigUint vi;  // r^e mod(n)
+    BigUint vf;  // r^(-1) mod(n)
+    int uses = 0;
+  };
+
+  struct crt_prime {
+    std::unique_ptr<const Montgomery> mont;
+    Montgomery::exponent d;
+    // r_1 * .. * r_(i-1), only used from the third prime on
+    BigUint product;
+  };
+
+  void _init_exponents_();
+  BigUint _crt_pow_(const BigUint& c, size_t i) const {
+    return _primes[i].mont->pow(c, _primes[i].d);
+  }
+  void _blinded_private_op_(const BigUint *c, BigUint *m, size_t n, bool parallel) const;
+  // the value mod(n) from its residues m[i] mod(prime(i))
+  BigUint _recombine_(const std::vector<BigUint>& m) const;
+  blinding _new_blinding_() const;
+
+  rsa_key _key;
+  std::unique_ptr<const Montgomery> _mont_n;
+  Montgomery::exponent _e;
+  // p, q and the other primes, empty for a public key
+  std::vector<crt_prime> _primes;
+  // idle blinding pairs, one is taken per call so threads sharing
+  // the context do not wait on each other
+  mutable std::mutex _blinding_lock;
+  mutable std::vector<blinding> _blindings;
+};
+
 class rsa {
 public:
   rsa() {}
+  explicit rsa(const rsa_key& key):_ctx{std::make_shared<rsa_context>(key)} {}
+  explicit rsa(std::shared_ptr<const rsa_context> ctx):_ctx{std::move(ctx)} {}
   rsa(const rsa&) = delete;
   rsa(rsa&&) = delete;
   ~rsa() = default;
 
-  void init();
+  // generate a new key pair of `primes` primes, n has exactly `bits` bits
+  void keygen(int bits, uint32_t e = 65537, int primes = 2);
+
+  static const int MAX_PRIMES = 4;
+  // most primes for a key of the size that still leaves every prime
+  // large enough, the limits openssl uses
+  static int max_primes(int bits) {
+    return bits < 1024 ? 2 : bits < 4096 ? 3 : 4;
+  }
+
+  const rsa_key& key() const { return _ctx->key(); }
+
+  // raw RSA on integers below n
+  BigUint encrypt(const BigUint& m) const { return _ctx->public_op(m); }
+  BigUint decrypt(const BigUint& c) const { return _private_op_(c); }
+  BigUint sign(const BigUint& m) const { return _private_op_(m); }
+  BigUint verify(const BigUint& s) const { return _ctx->public_op(s); }
+
+  // blinding of private operations is on by default
+  void set_blinding(bool on) { _blinding = on; }
+  // per-prime exponentiations of a private operation on their own
+  // threads, cuts the latency of one call on an idle multi-core host.
+  // off by default, it only oversubscribes an already busy one
+  void set_parallel(bool on) { _parallel = on; }
+  const std::shared_ptr<const rsa_context>& context() const { return _ctx; }
+
 private:
+  BigUint _private_op_(const BigUint& c) const {
+    return _blinding ? _ctx->blinded_private_op(c, _parallel) : _ctx->private_op(c, _parallel);
+  }
 
+  std::shared_ptr<const rsa_context> _ctx;
+  bool _blinding = true;
+  bool _parallel = false;
 };
 
 } // simple_rsa
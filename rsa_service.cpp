@@ -0,0 +1,261 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "rsa_service.h"
+
+namespace simple_rsa {
+
+namespace {
+
+bool is_private(rsa_op op) {
+  return op == RSA_DECRYPT || op == RSA_SIGN;
+}
+
+// below 16 ns one bucket per ns, then 4 per power of 2
+int bucket(uint64_t ns) {
+  if (ns < 16) {
+    return ns;
+  }
+  const int k = 63 - __builtin_clzll(ns);
+  return 4 * k + (int)((ns >> (k - 2)) & 3);
+}
+
+// upper end of a bucket in ns
+double bucket_top(int b) {
+  if (b < 16) {
+    return b + 1;
+  }
+  return std::ldexp(4 + b % 4 + 1, b / 4 - 2);
+}
+
+} // namespace
+
+RsaService::RsaService(int threads, size_t queue_size, size_t max_batch, bool blinding)
+    :_queue{queue_size},
+     _threads{threads > 0 ? (size_t)threads : std::max(1u, std::thread::hardware_concurrency())},
+     _max_batch{std::max<size_t>(max_batch, 1)}, _blinding{blinding},
+     _pending{0}, _sleeping{0}, _stop{false}, _submitted{0}, _completed{0}, _rejected{0},
+     _batches{0}, _max_depth{0} {
+  for (auto& b : _latency) {
+    b.store(0, std::memory_order_relaxed);
+  }
+  for (size_t i = 0; i < _threads; ++i) {
+    _workers.emplace_back(&RsaService::_worker_, this);
+  }
+}
+
+RsaService::~RsaService() {
+  {
+    std::lock_guard<std::mutex> guard(_lock);
+    _stop = true;
+  }
+  _wake.notify_all();
+  for (auto& t : _workers) {
+    t.join();
+  }
+}
+
+std::future<BigUint> RsaService::submit(rsa_op op, context_ptr key, BigUint input) {
+  request r;
+  r.op = op;
+  r.key = std::move(key);
+  r.input = std::move(input);
+  std::future<BigUint> f = r.promise.get_future();
+  if (!r.key) {
+    r.promise.set_exception(std::make_exception_ptr(std::invalid_argument("simple_rsa: no key")));
+  } else if (is_private(op) && !r.key->key().is_private()) {
+    r.promise.set_exception(std::make_exception_ptr(std::invalid_argument("simple_rsa: not a private key")));
+  } else if (!_push_(std::move(r))) {
+    r.promise.set_exception(std::make_exception_ptr(std::runtime_error("simple_rsa: service queue full")));
+  }
+  return f;
+}
+
+bool RsaService::submit(rsa_op op, context_ptr key, BigUint input, callback done) {
+  if (!key) {
+    done(BigUint(), std::make_exception_ptr(std::invalid_argument("simple_rsa: no key")));
+    return true;
+  }
+  if (is_private(op) && !key->key().is_private()) {
+    done(BigUint(), std::make_exception_ptr(std::invalid_argument("simple_rsa: not a private key")));
+    return true;
+  }
+  request r;
+  r.op = op;
+  r.key = std::move(key);
+  r.input = std::move(input);
+  r.done = std::move(done);
+  return _push_(std::move(r));
+}
+
+bool RsaService::_push_(request&& r) {
+  r.start = clock::now();
+  ++_submitted;
+  if (!_queue.try_push(std::move(r))) {
+    --_submitted;
+    ++_rejected;
+    return false;
+  }
+  // _pending and _sleeping are seq_cst on both sides: either this load
+  // sees the worker's ++_sleeping, or the worker's predicate sees the
+  // new _pending. a worker that counted itself holds the lock until it
+  // waits, so the notify under the lock reaches it
+  const long pending = ++_pending;
+  const size_t depth = pending > 0 ? pending : 0;
+  size_t max = _max_depth.load(std::memory_order_relaxed);
+  while (depth > max && !_max_depth.compare_exchange_weak(max, depth, std::memory_order_relaxed)) {
+  }
+  if (_sleeping.load() > 0) {
+    std::lock_guard<std::mutex> guard(_lock);
+    _wake.notify_one();
+  }
+  return true;
+}
+
+bool RsaService::_wait_() {
+  std::unique_lock<std::mutex> lock(_lock);
+  ++_sleeping;
+  _wake.wait(lock, [this] { return _pending.load() > 0 || _stop; });
+  --_sleeping;
+  return _pending.load() > 0 || !_stop;
+}
+
+bool RsaService::_pop_(request& r) {
+  if (!_queue.try_pop(r)) {
+    return false;
+  }
+  --_pending;
+  return true;
+}
+
+void RsaService::_worker_() {
+  std::vector<request> batch;
+  request r;
+  for (;;) {
+    if (!_pop_(r)) {
+      if (_pending.load() > 0) {
+        // published, but behind a cell another producer has claimed and
+        // not yet filled, or just taken by another worker
+        std::this_thread::yield();
+      } else if (!_wait_()) {
+        return;
+      }
+      continue;
+    }
+    batch.push_back(std::move(r));
+    // batch only when requests are waiting, a quiet service answers
+    // every request on its own
+    const long pending = _pending.load(std::memory_order_relaxed);
+    const size_t want = std::min(_max_batch, 1 + (pending > 0 ? pending : 0) / _threads);
+    while (batch.size() < want && _pop_(r)) {
+      batch.push_back(std::move(r));
+    }
+    if (batch.size() > 1) {
+      ++_batches;
+    }
+    _run_(batch);
+    batch.clear();
+  }
+}
+
+void RsaService::_run_(std::vector<request>& batch) {
+  std::stable_sort(batch.begin(), batch.end(), [](const request& a, const request& b) {
+    return a.key.get() < b.key.get();
+  });
+  std::vector<request*> group;
+  std::vector<BigUint> in, out;
+  for (size_t i = 0; i < batch.size();) {
+    const rsa_context& ctx = *batch[i].key;
+    group.clear();
+    for (; i < batch.size() && batch[i].key.get() == &ctx; ++i) {
+      request& r = batch[i];
+      if (is_private(r.op)) {
+        group.push_back(&r);
+        continue;
+      }
+      BigUint result;
+      std::exception_ptr error;
+      try {
+        result = ctx.public_op(r.input);
+      } catch (...) {
+        error = std::current_exception();
+      }
+      _finish_(r, result, error);
+    }
+    if (group.empty()) {
+      continue;
+    }
+    // the private operations on one key together
+    in.clear();
+    for (request *r : group) {
+      in.push_back(std::move(r->input));
+    }
+    out.resize(in.size());
+    std::exception_ptr error;
+    try {
+      if (_blinding) {
+        ctx.blinded_private_op(in.data(), out.data(), in.size());
+      } else {
+        for (size_t k = 0; k < in.size(); ++k) {
+          out[k] = ctx.private_op(in[k]);
+        }
+      }
+    } catch (...) {
+      error = std::current_exception();
+    }
+    for (size_t k = 0; k < group.size(); ++k) {
+      _finish_(*group[k], error ? BigUint() : out[k], error);
+    }
+  }
+}
+
+void RsaService::_finish_(request& r, const BigUint& result, std::exception_ptr error) {
+  const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - r.start).count();
+  _latency[bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+  ++_completed;
+  if (r.done) {
+    r.done(result, error);
+  } else if (error) {
+    r.promise.set_exception(error);
+  } else {
+    r.promise.set_value(result);
+  }
+}
+
+double RsaService::_percentile_(double p) const {
+  uint64_t counts[BUCKETS];
+  uint64_t total = 0;
+  for (int i = 0; i < BUCKETS; ++i) {
+    counts[i] = _latency[i].load(std::memory_order_relaxed);
+    total += counts[i];
+  }
+  if (total == 0) {
+    return 0;
+  }
+  const uint64_t rank = (uint64_t)std::ceil(p * total);
+  uint64_t seen = 0;
+  for (int i = 0; i < BUCKETS; ++i) {
+    seen += counts[i];
+    if (seen >= rank) {
+      return bucket_top(i) / 1e3;
+    }
+  }
+  return bucket_top(BUCKETS - 1) / 1e3;
+}
+
+RsaService::stats RsaService::statistics() const {
+  stats st;
+  st.submitted = _submitted;
+  st.completed = _completed;
+  st.rejected = _rejected;
+  st.batches = _batches;
+  st.queue_depth = std::max(_pending.load(), 0l);
+  st.max_queue_depth = _max_depth;
+  st.p50 = _percentile_(0.5);
+  st.p99 = _percentile_(0.99);
+  st.p999 = _percentile_(0.999);
+  return st;
+}
+
+} // namespace simple_rsa
@@ -0,0 +1,124 @@
+#ifndef _RSA_SERVICE_H__
+#define _RSA_SERVICE_H__ 1
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "mpmc_queue.h"
+#include "rsa.h"
+
+namespace simple_rsa {
+
+enum rsa_op {
+  RSA_ENCRYPT,
+  RSA_DECRYPT,
+  RSA_SIGN,
+  RSA_VERIFY,
+};
+
+// asynchronous front end of rsa_context for servers: submit() returns
+// at once and a fixed pool of workers takes requests from a lock-free
+// queue. a worker that finds more requests waiting takes up to
+// max_batch of them, roughly the queue depth shared among the workers,
+// and runs the ones on the same key back to back through the batch
+// form of the private operation.
+class RsaService {
+public:
+  typedef std::shared_ptr<const rsa_context> context_ptr;
+  // result, or the error with a default result. runs on a worker, it
+  // must not throw and should not block
+  typedef std::function<void(const BigUint&, std::exception_ptr)> callback;
+
+  struct stats {
+    uint64_t submitted;
+    uint64_t completed;
+    // refused because the queue was full
+    uint64_t rejected;
+    uint64_t batches;
+    size_t queue_depth;
+    size_t max_queue_depth;
+    // submit to completion in microseconds, at most 25% high
+    double p50;
+    double p99;
+    double p999;
+  };
+
+  // threads == 0 uses one per cpu. private operations are blinded
+  // unless blinding is false
+  explicit RsaService(int threads = 0, size_t queue_size = 4096,
+                      size_t max_batch = 16, bool blinding = true);
+  // finishes everything queued
+  ~RsaService();
+  RsaService(const RsaService&) = delete;
+  RsaService& operator=(const RsaService&) = delete;
+
+  // the future holds std::invalid_argument for a missing key or a
+  // private operation on a public key, std::runtime_error if the
+  // queue is full
+  std::future<BigUint> submit(rsa_op op, context_ptr key, BigUint input);
+  // false, without calling done, if the queue is full. errors in the
+  // request itself go to done
+  bool submit(rsa_op op, context_ptr key, BigUint input, callback done);
+
+  stats statistics() const;
+
+private:
+  typedef std::chrono::steady_clock clock;
+
+  struct request {
+    rsa_op op;
+    context_ptr key;
+    BigUint input;
+    // exactly one of them is used
+    std::promise<BigUint> promise;
+    callback done;
+    clock::time_point start;
+  };
+
+  // latency histogram, 4 buckets per power of 2 nanoseconds
+  static const int BUCKETS = 256;
+
+  bool _push_(request&& r);
+  void _worker_();
+  // false once stopped and drained
+  bool _wait_();
+  bool _pop_(request& r);
+  void _run_(std::vector<request>& batch);
+  void _finish_(request& r, const BigUint& result, std::exception_ptr error);
+  double _percentile_(double p) const;
+
+  MpmcQueue<request> _queue;
+  const size_t _threads;
+  const size_t _max_batch;
+  const bool _blinding;
+  std::vector<std::thread> _workers;
+
+  // requests pushed and fully published but not yet popped, unlike
+  // _queue.size() that also counts cells a producer has only claimed.
+  // briefly negative when a worker pops before the producer counts
+  std::atomic<long> _pending;
+  // sleeping workers wait here, producers only lock it when one sleeps
+  std::mutex _lock;
+  std::condition_variable _wake;
+  std::atomic<int> _sleeping;
+  std::atomic<bool> _stop;
+
+  std::atomic<uint64_t> _submitted;
+  std::atomic<uint64_t> _completed;
+  std::atomic<uint64_t> _rejected;
+  std::atomic<uint64_t> _batches;
+  std::atomic<size_t> _max_depth;
+  std::atomic<uint64_t> _latency[BUCKETS];
+};
+
+} // namespace simple_rsa
+
+#endif // _RSA_SERVICE_H__
@@ -0,0 +1,44 @@
+#include "scratch.h"
+
+namespace simple_rsa {
+
+uint32_t* Scratch::alloc(size_t n) {
+  // multiple of 4 uint32 keeps every block 16 bytes aligned
+  n = (n + 3) & ~(size_t)3;
+  while (_chunk < _chunks.size() && _chunks[_chunk].size - _pos < n) {
+    ++_chunk;
+    _pos = 0;
+  }
+  if (_chunk == _chunks.size()) {
+    size_t size = capacity();
+    if (size < MIN_CHUNK) {
+      size = MIN_CHUNK;
+    }
+    if (size < n) {
+      size = n;
+    }
+    _chunks.push_back(chunk{std::unique_ptr<uint32_t[]>(new uint32_t[size]), size});
+  }
+  uint32_t *p = _chunks[_chunk].p.get() + _pos;
+  _pos += n;
+  _used += n;
+  if (_high_water < _used) {
+    _high_water = _used;
+  }
+  return p;
+}
+
+size_t Scratch::capacity() const {
+  size_t n = 0;
+  for (const chunk& c : _chunks) {
+    n += c.size;
+  }
+  return n;
+}
+
+Scratch& Scratch::local() {
+  static thread_local Scratch scratch;
+  return scratch;
+}
+
+} // namespace simple_rsa
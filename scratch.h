@@ -0,0 +1,81 @@
+#ifndef _SCRATCH_H__
+#define _SCRATCH_H__ 1
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace simple_rsa {
+
+using std::size_t;
+using std::uint32_t;
+
+// per-thread bump allocator for the uint32 temporaries of division,
+// montgomery multiplication and primality testing. memory is taken in
+// chunks that are kept for the life of the thread, so once a thread has
+// seen its largest operands those loops run without touching the heap.
+// every allocation belongs to the innermost Scope and is released, in
+// bulk, when that Scope ends.
+class Scratch {
+public:
+  Scratch() = default;
+  Scratch(const Scratch&) = delete;
+  Scratch& operator=(const Scratch&) = delete;
+
+  // arena of the calling thread
+  static Scratch& local();
+
+  // uninitialized, 16 bytes aligned
+  uint32_t* alloc(size_t n);
+
+  // uint32 handed out and not yet released
+  size_t used() const { return _used; }
+  // the largest used() so far
+  size_t high_water() const { return _high_water; }
+  void reset_high_water() { _high_water = _used; }
+  // uint32 held in chunks
+  size_t capacity() const;
+
+  // reset point, everything allocated after it is released on exit
+  class Scope {
+  public:
+    Scope():Scope(Scratch::local()) {}
+    explicit Scope(Scratch& s):_s(s), _chunk(s._chunk), _pos(s._pos), _used(s._used) {}
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+    ~Scope() {
+      _s._chunk = _chunk;
+      _s._pos = _pos;
+      _s._used = _used;
+    }
+
+    uint32_t* alloc(size_t n) { return _s.alloc(n); }
+
+  private:
+    Scratch& _s;
+    const size_t _chunk;
+    const size_t _pos;
+    const size_t _used;
+  };
+
+private:
+  // the first chunk, later ones at least double the capacity
+  static const size_t MIN_CHUNK = 4096;
+
+  struct chunk {
+    std::unique_ptr<uint32_t[]> p;
+    size_t size;
+  };
+
+  std::vector<chunk> _chunks;
+  // current chunk and position in it, chunks after it are free
+  size_t _chunk = 0;
+  size_t _pos = 0;
+  size_t _used = 0;
+  size_t _high_water = 0;
+};
+
+} // namespace simple_rsa
+
+#endif // _SCRATCH_H__
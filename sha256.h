@@ -0,0 +1,38 @@
+#ifndef _SHA256_H__
+#define _SHA256_H__ 1
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace simple_rsa {
+
+using std::uint8_t;
+using std::uint32_t;
+using std::uint64_t;
+
+// SHA-256 (FIPS 180-4)
+class Sha256 {
+public:
+  typedef std::array<uint8_t, 32> digest;
+
+  Sha256();
+  void update(const uint8_t *p, size_t n);
+  // the object is reset afterwards
+  digest finish();
+
+  static digest hash(const uint8_t *p, size_t n);
+
+private:
+  void _reset_();
+  void _block_(const uint8_t *p);
+
+  uint32_t _h[8];
+  uint8_t _buffer[64];
+  size_t _used;
+  uint64_t _length;
+};
+
+} // namespace simple_rsa
+
+#endif // _SHA256_H__
@@ -1,11 +1,233 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
 #include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <thread>
 #include <boost/program_options.hpp>
+#include "key_file.h"
+#include "pkcs1.h"
 #include "rsa.h"
 
 using namespace std;
 using namespace simple_rsa;
 namespace po = boost::program_options;
 
+namespace {
+
+vector<uint8_t> read_all(istream& in) {
+  return vector<uint8_t>(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+}
+
+// --name or stdin
+vector<uint8_t> read_input(const po::variables_map& vm, const char *name = "input") {
+  if (!vm.count(name)) {
+    return read_all(cin);
+  }
+  ifstream in(vm[name].as<string>(), ios::binary);
+  if (!in) {
+    throw runtime_error("can not open " + vm[name].as<string>());
+  }
+  return read_all(in);
+}
+
+// --output or stdout
+void write_output(const po::variables_map& vm, const vector<uint8_t>& data) {
+  if (!vm.count("output")) {
+    cout.write((const char*)data.data(), data.size());
+    return;
+  }
+  ofstream out(vm["output"].as<string>(), ios::binary);
+  out.write((const char*)data.data(), data.size());
+  if (!out) {
+    throw runtime_error("can not write " + vm["output"].as<string>());
+  }
+}
+
+rsa_key load(const po::variables_map& vm, bool need_private) {
+  rsa_key key = load_key(vm["key"].as<string>());
+  if (need_private && !key.is_private()) {
+    throw runtime_error(vm["key"].as<string>() + " is not a private key");
+  }
+  return key;
+}
+
+// the key sizes rsa::keygen accepts, it only asserts them
+void check_key_size(int bits, int primes) {
+  if (bits < 128 || bits % 2 != 0) {
+    throw runtime_error("bits must be even and at least 128");
+  }
+  if (primes < 2 || primes > rsa::max_primes(bits)) {
+    throw runtime_error("a " + to_string(bits) + " bits key has 2 to " +
+                        to_string(rsa::max_primes(bits)) + " primes");
+  }
+}
+
+int keygen(const po::variables_map& vm) {
+  const int bits = vm["bits"].as<int>();
+  const int primes = vm["primes"].as<int>();
+  check_key_size(bits, primes);
+  rsa r;
+  r.keygen(bits, 65537, primes);
+  save_key(vm["key"].as<string>(), r.key(), vm.count("pem") > 0);
+  return 0;
+}
+
+int encrypt(const po::variables_map& vm) {
+  const rsa r(load(vm, false));
+  const vector<uint8_t> m = read_input(vm);
+  write_output(vm, pkcs1_encrypt(r, m.data(), m.size()));
+  return 0;
+}
+
+int decrypt(const po::variables_map& vm) {
+  const rsa r(load(vm, true));
+  const vector<uint8_t> c = read_input(vm);
+  write_output(vm, pkcs1_decrypt(r, c.data(), c.size()));
+  return 0;
+}
+
+int sign(const po::variables_map& vm) {
+  const rsa r(load(vm, true));
+  const vector<uint8_t> m = read_input(vm);
+  write_output(vm, pkcs1_sign(r, m.data(), m.size()));
+  return 0;
+}
+
+int verify(const po::variables_map& vm) {
+  const rsa r(load(vm, false));
+  if (!vm.count("signature")) {
+    throw runtime_error("verify needs --signature");
+  }
+  const vector<uint8_t> m = read_input(vm);
+  const vector<uint8_t> s = read_input(vm, "signature");
+  const bool ok = pkcs1_verify(r, m.data(), m.size(), s.data(), s.size());
+  cout<<(ok ? "OK" : "FAILED")<<endl;
+  return ok ? 0 : 1;
+}
+
+struct bench_result {
+  double ops;
+  // microseconds
+  double p50;
+  double p99;
+  double p999;
+};
+
+// run op on each of threads threads for seconds
+bench_result run_bench(const function<void()>& op, int threads, double seconds) {
+  typedef chrono::steady_clock clock;
+  vector<vector<double>> latencies(threads);
+  vector<thread> workers;
+  const clock::time_point start = clock::now();
+  const clock::time_point end = start + chrono::duration_cast<clock::duration>(chrono::duration<double>(seconds));
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t]() {
+      for (clock::time_point now = clock::now(); now < end;) {
+        op();
+        const clock::time_point done = clock::now();
+        latencies[t].push_back(chrono::duration<double, micro>(done - now).count());
+        now = done;
+      }
+    });
+  }
+  for (auto& w : workers) {
+    w.join();
+  }
+  const double elapsed = chrono::duration<double>(clock::now() - start).count();
+  vector<double> all;
+  for (auto& l : latencies) {
+    all.insert(all.end(), l.begin(), l.end());
+  }
+  sort(all.begin(), all.end());
+  auto percentile = [&all](double p) {
+    return all.empty() ? 0 : all[min(all.size() - 1, (size_t)(p * all.size()))];
+  };
+  return bench_result{all.size() / elapsed, percentile(0.5), percentile(0.99), percentile(0.999)};
+}
+
+int bench(const po::variables_map& vm) {
+  const double seconds = vm["duration"].as<double>();
+  if (!(seconds > 0)) {
+    throw runtime_error("duration must be positive");
+  }
+  vector<int> threads;
+  if (vm.count("threads")) {
+    threads = vm["threads"].as<vector<int>>();
+    for (int t : threads) {
+      if (t < 1) {
+        throw runtime_error("thread counts must be at least 1");
+      }
+    }
+  } else {
+    const int cpus = max(1u, thread::hardware_concurrency());
+    for (int t = 1; t < cpus; t *= 2) {
+      threads.push_back(t);
+    }
+    threads.push_back(cpus);
+  }
+  unique_ptr<rsa> key;
+  if (vm.count("key")) {
+    key.reset(new rsa(load(vm, true)));
+  } else {
+    const int bits = vm["bits"].as<int>();
+    const int primes = vm["primes"].as<int>();
+    check_key_size(bits, primes);
+    cout<<"generating a "<<bits<<" bits key"<<endl;
+    key.reset(new rsa);
+    key->keygen(bits, 65537, primes);
+  }
+  key->set_parallel(vm.count("parallel") > 0);
+  const rsa& r = *key;
+  vector<string> ops = {"encrypt", "decrypt", "sign", "verify"};
+  if (vm.count("ops")) {
+    ops = vm["ops"].as<vector<string>>();
+  }
+
+  const vector<uint8_t> m(32, 0x5a);
+  const vector<uint8_t> c = pkcs1_encrypt(r, m.data(), m.size());
+  const vector<uint8_t> s = pkcs1_sign(r, m.data(), m.size());
+  const int bits = r.key().bits();
+  const int primes = r.key().primes();
+  map<string, function<void()>> table = {
+    {"keygen", [bits, primes]() { rsa k; k.keygen(bits, 65537, primes); }},
+    {"encrypt", [&]() { pkcs1_encrypt(r, m.data(), m.size()); }},
+    {"decrypt", [&]() { pkcs1_decrypt(r, c.data(), c.size()); }},
+    {"sign", [&]() { pkcs1_sign(r, m.data(), m.size()); }},
+    {"verify", [&]() { pkcs1_verify(r, m.data(), m.size(), s.data(), s.size()); }},
+  };
+
+  cout<<bits<<" bits, "<<primes<<" primes, "<<seconds<<" s per run, latency in microseconds\n"
+      <<left<<setw(10)<<"op"<<right<<setw(8)<<"threads"<<setw(12)<<"ops/s"
+      <<setw(10)<<"p50"<<setw(10)<<"p99"<<setw(10)<<"p99.9"<<setw(10)<<"scaling"<<endl;
+  cout<<fixed;
+  for (const string& name : ops) {
+    auto it = table.find(name);
+    if (it == table.end()) {
+      throw runtime_error("unknown operation " + name);
+    }
+    // per thread rate against the first thread count
+    double base = 0;
+    for (int t : threads) {
+      const bench_result b = run_bench(it->second, t, seconds);
+      if (base == 0) {
+        base = b.ops / t;
+      }
+      cout<<left<<setw(10)<<name<<right<<setw(8)<<t<<setprecision(1)<<setw(12)<<b.ops
+          <<setw(10)<<b.p50<<setw(10)<<b.p99<<setw(10)<<b.p999
+          <<setprecision(2)<<setw(10)<<b.ops / t / base<<endl;
+    }
+  }
+  return 0;
+}
+
+} // namespace
+
 int main(int argc, char *argv[]) {
   po::options_description general_desc("General options");
   general_desc.add_options()
@@ -17,6 +239,8 @@ int main(int argc, char *argv[]) {
   argv_desc.add_options()
     ("bits,b", po::value<int>()->default_value(1024), "bits of the key, 1024|2048")
     ("key,k", po::value<string>()->default_value("simple_rsa_key"), "key file name")
+    ("pem", "write a PEM key instead of the binary key file")
+    ("primes,p", po::value<int>()->default_value(2), "primes of the key, up to 3 from 1024 bits and 4 from 4096")
     ;
   po::options_description crypt_desc("Encrypt/Decrypt options");
   crypt_desc.add_options()
@@ -24,17 +248,31 @@ int main(int argc, char *argv[]) {
     ("input,i", po::value<string>(), "input file")
     ("output,o", po::value<string>(), "output file")
     ;
-  po::options_description sign_desc("Sign/Verify options");
+  po::options_description sign_desc("Sign options");
   sign_desc.add_options()
     ("key,k", po::value<string>()->default_value("simple_rsa_key"), "key file name")
+    ("input,i", po::value<string>(), "message file")
+    ("output,o", po::value<string>(), "signature file")
     ;
   po::options_description verify_desc("Verify options");
   verify_desc.add_options()
-    ("output,o", po::value<string>(), "output file")
+    ("key,k", po::value<string>()->default_value("simple_rsa_key"), "key file name")
+    ("input,i", po::value<string>(), "message file")
+    ("signature,s", po::value<string>(), "signature file")
+    ;
+  po::options_description bench_desc("Bench options");
+  bench_desc.add_options()
+    ("bits,b", po::value<int>()->default_value(2048), "bits of the generated key")
+    ("key,k", po::value<string>(), "private key file instead of a generated key")
+    ("primes,p", po::value<int>()->default_value(2), "primes of the generated key")
+    ("parallel", "per-prime exponentiations of a private operation on their own threads")
+    ("duration,d", po::value<double>()->default_value(2), "seconds per operation and thread count")
+    ("threads,t", po::value<vector<int>>()->multitoken(), "thread counts, default 1, 2, 4, .. up to the cpus")
+    ("ops", po::value<vector<string>>()->multitoken(), "encrypt decrypt sign verify keygen, default all but keygen")
     ;
 
   po::options_description all;
-  all.add(general_desc).add(argv_desc).add(crypt_desc).add(sign_desc).add(verify_desc);
+  all.add(general_desc).add(argv_desc).add(crypt_desc).add(sign_desc).add(verify_desc).add(bench_desc);
 
   po::options_description cmd_po("cmd options");
   cmd_po.add_options()
@@ -57,7 +295,7 @@ int main(int argc, char *argv[]) {
 
   if(vm.size() == 0 || vm.count("help")) {
   cout<<"usage: simple_rsa [--version] [--help] <command> [<args>]\n"<<
-      "  command: keygen | encrypt | decrypt | sign | verify\n"<<
+      "  command: keygen | encrypt | decrypt | sign | verify | bench\n"<<
       all<<"\n"<<
       "Bug report: <exiledkingcc@gmail.com>"<<endl;
   exit(0);
@@ -68,5 +306,34 @@ int main(int argc, char *argv[]) {
       "this is just a demo, do NOT use it at work!"<<endl;
   exit(0);
   }
-  return 0;
+
+  typedef int (*command)(const po::variables_map&);
+  const struct { const char *name; const po::options_description *desc; command run; } commands[] = {
+    {"keygen", &argv_desc, keygen},
+    {"encrypt", &crypt_desc, encrypt},
+    {"decrypt", &crypt_desc, decrypt},
+    {"sign", &sign_desc, sign},
+    {"verify", &verify_desc, verify},
+    {"bench", &bench_desc, bench},
+  };
+  const string cmd = vm.count("cmd") ? vm["cmd"].as<string>() : "";
+  for (auto& c : commands) {
+    if (cmd != c.name) {
+      continue;
+    }
+    // everything after the command, parsed with its own options
+    vector<string> args = po::collect_unrecognized(parsed.options, po::include_positional);
+    args.erase(args.begin());
+    try {
+      po::variables_map cvm;
+      po::store(po::command_line_parser(args).options(*c.desc).run(), cvm);
+      po::notify(cvm);
+      return c.run(cvm);
+    } catch (const exception& e) {
+      cerr<<"simple_rsa "<<cmd<<": "<<e.what()<<endl;
+      return 2;
+    }
+  }
+  cerr<<"simple_rsa: unknown command '"<<cmd<<"', see --help"<<endl;
+  return 2;
 }
@@ -0,0 +1,29 @@
+#ifndef _CHECK_H__
+#define _CHECK_H__ 1
+
+#include <iostream>
+
+// the harness of the test programs: check() reports a failed condition
+// and counts it, main ends with return report()
+
+inline int& failed_checks() {
+  static int failed = 0;
+  return failed;
+}
+
+inline void check(bool ok, const char *what) {
+  if (!ok) {
+    std::cout<<"FAILED: "<<what<<std::endl;
+    ++failed_checks();
+  }
+}
+
+// "all passed" when nothing failed, the exit status of the test
+inline int report() {
+  if (failed_checks() == 0) {
+    std::cout<<"all passed"<<std::endl;
+  }
+  return failed_checks() == 0 ? 0 : 1;
+}
+
+#endif // _CHECK_H__
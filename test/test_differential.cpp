@@ -0,0 +1,470 @@
+// differential test of the BigUint kernels against small, obviously
+// correct reference implementations on plain limb vectors.
+//
+// usage: test_differential [cases per thread] [seed] [threads]
+// a failure prints the operands and the seed of the thread it ran on.
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "drbg.h"
+#include "fixed_base.h"
+#include "montgomery.h"
+
+using namespace std;
+using namespace simple_rsa;
+
+typedef vector<uint32_t> limbs;
+
+// ---- reference implementations ----
+
+void trim(limbs& a) {
+  while (a.size() > 1 && a.back() == 0) {
+    a.pop_back();
+  }
+  if (a.empty()) {
+    a.push_back(0);
+  }
+}
+
+int ref_cmp(const limbs& a, const limbs& b) {
+  if (a.size() != b.size()) {
+    return a.size() < b.size() ? -1 : 1;
+  }
+  for (size_t i = a.size(); i-- > 0;) {
+    if (a[i] != b[i]) {
+      return a[i] < b[i] ? -1 : 1;
+    }
+  }
+  return 0;
+}
+
+limbs ref_add(const limbs& a, const limbs& b) {
+  limbs c(max(a.size(), b.size()) + 1);
+  uint64_t carry = 0;
+  for (size_t i = 0; i < c.size(); ++i) {
+    carry += (uint64_t)(i < a.size() ? a[i] : 0) + (i < b.size() ? b[i] : 0);
+    c[i] = carry;
+    carry >>= 32;
+  }
+  trim(c);
+  return c;
+}
+
+// a >= b
+limbs ref_sub(const limbs& a, const limbs& b) {
+  limbs c(a.size());
+  uint32_t borrow = 0;
+  for (size_t i = 0; i < a.size(); ++i) {
+    uint64_t x = (uint64_t)(i < b.size() ? b[i] : 0) + borrow;
+    c[i] = a[i] - (uint32_t)x;
+    borrow = a[i] < x;
+  }
+  trim(c);
+  return c;
+}
+
+limbs ref_mul(const limbs& a, const limbs& b) {
+  limbs c(a.size() + b.size());
+  for (size_t i = 0; i < a.size(); ++i) {
+    uint64_t carry = 0;
+    for (size_t j = 0; j < b.size(); ++j) {
+      carry += (uint64_t)a[i] * b[j] + c[i + j];
+      c[i + j] = carry;
+      carry >>= 32;
+    }
+    c[i + b.size()] = carry;
+  }
+  trim(c);
+  return c;
+}
+
+limbs ref_shl(const limbs& a, int n) {
+  limbs c(a.size() + n / 32 + 1);
+  for (size_t i = 0; i < a.size() * 32; ++i) {
+    if (a[i / 32] >> (i % 32) & 1) {
+      size_t k = i + n;
+      c[k / 32] |= 1u << (k % 32);
+    }
+  }
+  trim(c);
+  return c;
+}
+
+limbs ref_shr(const limbs& a, int n) {
+  limbs c(a.size());
+  for (size_t i = n; i < a.size() * 32; ++i) {
+    if (a[i / 32] >> (i % 32) & 1) {
+      size_t k = i - n;
+      c[k / 32] |= 1u << (k % 32);
+    }
+  }
+  trim(c);
+  return c;
+}
+
+// binary long division, b > 0
+void ref_divmod(const limbs& a, const limbs& b, limbs& q, limbs& r) {
+  const size_t n = b.size() + 1;
+  q.assign(a.size(), 0);
+  r.assign(n, 0);
+  for (size_t i = a.size() * 32; i-- > 0;) {
+    // r = 2r + bit i of a
+    for (size_t k = n - 1; k > 0; --k) {
+      r[k] = (r[k] << 1) | (r[k - 1] >> 31);
+    }
+    r[0] = (r[0] << 1) | (a[i / 32] >> (i % 32) & 1);
+    // r >= b ?
+    bool ge = r[n - 1] != 0;
+    if (!ge) {
+      size_t k = b.size();
+      while (k-- > 0 && r[k] == b[k]) {
+      }
+      ge = k == (size_t)-1 || r[k] > b[k];
+    }
+    if (ge) {
+      uint32_t borrow = 0;
+      for (size_t k = 0; k < n; ++k) {
+        uint64_t x = (uint64_t)(k < b.size() ? b[k] : 0) + borrow;
+        borrow = r[k] < x;
+        r[k] -= (uint32_t)x;
+      }
+      q[i / 32] |= 1u << (i % 32);
+    }
+  }
+  trim(q);
+  trim(r);
+}
+
+limbs ref_mod(const limbs& a, const limbs& n) {
+  limbs q, r;
+  ref_divmod(a, n, q, r);
+  return r;
+}
+
+// right to left square and multiply with plain reductions
+limbs ref_pow(const limbs& b, const limbs& e, const limbs& n) {
+  limbs t{1}, x = ref_mod(b, n);
+  for (size_t i = 0; i < e.size() * 32; ++i) {
+    if (e[i / 32] >> (i % 32) & 1) {
+      t = ref_mod(ref_mul(t, x), n);
+    }
+    x = ref_mod(ref_mul(x, x), n);
+  }
+  return ref_mod(t, n);
+}
+
+// ---- operands ----
+
+limbs to_limbs(const BigUint& b) {
+  return limbs(b.data(), b.data() + b.size());
+}
+
+BigUint from_limbs(const limbs& a) {
+  return BigUint(a.data(), a.size());
+}
+
+string hex(const limbs& a) {
+  return from_limbs(a).to_string();
+}
+
+// mostly small, sometimes up to `max` limbs
+int random_size(Drbg& rng, int max) {
+  return rng.uniform(4) != 0 ? 1 + rng.uniform(4) : 1 + rng.uniform(max);
+}
+
+// random operands biased to the edge cases of carries and borrows
+limbs random_limbs(Drbg& rng, int max = 24) {
+  const int n = random_size(rng, max);
+  limbs a(n);
+  switch (rng.uniform(8)) {
+  case 0:  // zero
+    a.assign(1, 0);
+    break;
+  case 1:  // all ones
+    a.assign(n, UINT32_MAX);
+    break;
+  case 2:  // a single bit
+    a[n - 1] = 1u << rng.uniform(32);
+    break;
+  case 3:  // zero limbs inside
+    rng.fill(a.data(), n);
+    for (auto& x : a) {
+      if (rng.uniform(2) == 0) {
+        x = 0;
+      }
+    }
+    break;
+  case 4:  // ones and zeros limbs
+    for (auto& x : a) {
+      x = rng.uniform(2) == 0 ? 0 : UINT32_MAX;
+    }
+    break;
+  case 5:  // small top limb, an unnormalized divisor
+    rng.fill(a.data(), n);
+    a[n - 1] = 1 + rng.uniform(255);
+    break;
+  default:
+    rng.fill(a.data(), n);
+    break;
+  }
+  trim(a);
+  return a;
+}
+
+// a second operand related to the first one half the time
+limbs related_limbs(Drbg& rng, const limbs& a) {
+  switch (rng.uniform(8)) {
+  case 0:
+    return a;
+  case 1:
+    return ref_add(a, limbs{1});
+  case 2:
+    return ref_cmp(a, limbs{0}) > 0 ? ref_sub(a, limbs{1}) : a;
+  case 3:
+    return ref_shr(a, rng.uniform(64));
+  default:
+    return random_limbs(rng);
+  }
+}
+
+// ---- checks ----
+
+struct tester {
+  explicit tester(uint32_t seed):rng{seeds(seed)}, seed{seed}, cases{0}, failures{0} {}
+
+  static const uint32_t* seeds(uint32_t seed) {
+    static thread_local uint32_t s[8];
+    for (int i = 0; i < 8; ++i) {
+      s[i] = seed + i;
+    }
+    return s;
+  }
+
+  void expect(bool ok, const char *op, const limbs& a, const limbs& b, const limbs& c = limbs()) {
+    ++cases;
+    if (ok) {
+      return;
+    }
+    ++failures;
+    static mutex out_lock;
+    lock_guard<mutex> guard(out_lock);
+    cout<<"FAILED: "<<op<<" seed "<<seed<<"\n  a = "<<hex(a)<<"\n  b = "<<hex(b);
+    if (!c.empty()) {
+      cout<<"\n  c = "<<hex(c);
+    }
+    cout<<endl;
+  }
+
+  void arithmetic() {
+    const limbs a = random_limbs(rng), b = related_limbs(rng, a);
+    const BigUint x = from_limbs(a), y = from_limbs(b);
+    const int c = ref_cmp(a, b);
+
+    expect((x < y) == (c < 0) && (x == y) == (c == 0) && (x > y) == (c > 0), "compare", a, b);
+    expect(to_limbs(x + y) == ref_add(a, b), "+", a, b);
+    expect(to_limbs(x * y) == ref_mul(a, b), "*", a, b);
+    if (c >= 0) {
+      expect(to_limbs(x - y) == ref_sub(a, b), "-", a, b);
+    } else {
+      expect(to_limbs(y - x) == ref_sub(b, a), "-", b, a);
+    }
+    if (y > 0) {
+      limbs q, r;
+      ref_divmod(a, b, q, r);
+      expect(to_limbs(x / y) == q, "/", a, b);
+      expect(to_limbs(x % y) == r, "%", a, b);
+    }
+
+    const uint32_t n = rng.uniform(4) == 0 ? UINT32_MAX - rng.uniform(3) : rng.next();
+    const limbs ln{n};
+    expect(to_limbs(x + n) == ref_add(a, ln), "+ uint32", a, ln);
+    expect(to_limbs(x * n) == ref_mul(a, ln), "* uint32", a, ln);
+    if (ref_cmp(a, ln) >= 0) {
+      expect(to_limbs(x - n) == ref_sub(a, ln), "- uint32", a, ln);
+    }
+    if (n > 0) {
+      limbs q, r;
+      ref_divmod(a, ln, q, r);
+      expect(to_limbs(x / n) == q, "/ uint32", a, ln);
+      expect(limbs{x % n} == r, "% uint32", a, ln);
+    }
+
+    // fused operations, also with the destination as an operand
+    const uint32_t k = rng.next(), j = rng.uniform(2) == 0 ? UINT32_MAX : rng.next();
+    const limbs lk{k}, lj{j};
+    BigUint f{x};
+    f += y * k;
+    expect(to_limbs(f) == ref_add(a, ref_mul(b, lk)), "addmul_1", a, b, lk);
+    f = x;
+    f += f * k;
+    expect(to_limbs(f) == ref_mul(a, ref_add(lk, limbs{1})), "addmul_1 aliased", a, lk);
+    f = x;
+    f += x * k + y * j;
+    expect(to_limbs(f) == ref_add(ref_add(a, ref_mul(a, lk)), ref_mul(b, lj)), "addmul_2", a, b, lk);
+    f = y;
+    f += x * k + f * j;
+    expect(to_limbs(f) == ref_add(ref_add(b, ref_mul(a, lk)), ref_mul(b, lj)), "addmul_2 aliased", a, b, lk);
+    f = x;
+    f += x * y;
+    expect(to_limbs(f) == ref_add(a, ref_mul(a, b)), "mul_add", a, b);
+    f = x;
+    f += y * k + x * y;
+    expect(to_limbs(f) == ref_add(ref_add(a, ref_mul(b, lk)), ref_mul(a, b)), "scaled + product", a, b, lk);
+    f = BigUint(x * y) + y;
+    f -= y * (uint32_t)1;
+    expect(to_limbs(f) == ref_mul(a, b), "submul_1", a, b);
+    f = BigUint(y * k) + x;
+    f -= y * k;
+    expect(to_limbs(f) == a, "submul_1 borrow", a, b, lk);
+    if (y > 0) {
+      expect(to_limbs(mul_mod(x, x, y)) == ref_mod(ref_mul(a, a), b), "mul_mod", a, b);
+      expect(to_limbs(mul_mod(x, y, y)) == limbs{0}, "mul_mod multiple", a, b);
+    }
+    if (x > 0) {
+      const limbs c = random_limbs(rng, 8);
+      expect(to_limbs(mul_mod(y, from_limbs(c), x)) == ref_mod(ref_mul(b, c), a), "mul_mod a * b", b, c, a);
+    }
+
+    const int s = rng.uniform(100);
+    const limbs ls{(uint32_t)s};
+    expect(to_limbs(x.left_shift(s)) == ref_shl(a, s), "left_shift", a, ls);
+    expect(to_limbs(x.right_shift(s)) == ref_shr(a, s), "right_shift", a, ls);
+    BigUint z{x};
+    z.right_shift(s);
+    expect(to_limbs(z) == ref_shr(a, s), "right_shift in place", a, ls);
+    z = x;
+    z.left_shift(s);
+    expect(to_limbs(z) == ref_shl(a, s), "left_shift in place", a, ls);
+
+    int bits = 0;
+    for (size_t i = 0; i < a.size() * 32; ++i) {
+      if (a[i / 32] >> (i % 32) & 1) {
+        bits = i + 1;
+      }
+    }
+    expect(x.bits() == bits, "bits", a, a);
+    const vector<uint8_t> bytes = x.to_bytes();
+    expect(BigUint::from_bytes(bytes.data(), bytes.size()) == x &&
+           bytes.size() == (size_t)(bits + 7) / 8, "to_bytes", a, a);
+  }
+
+  // odd modulus n > 1 with operands below it
+  limbs random_modulus(int max) {
+    limbs n = random_limbs(rng, max);
+    n[0] |= 1;
+    if (n.size() == 1 && n[0] == 1) {
+      n[0] = 3;
+    }
+    return n;
+  }
+
+  void modular() {
+    const limbs n = random_modulus(12);
+    const BigUint bn = from_limbs(n);
+    const limbs a = ref_mod(random_limbs(rng), n), b = ref_mod(related_limbs(rng, a), n);
+    const Montgomery mont(bn);
+
+    // mul(a, b) * R == a * b mod(n)
+    const limbs t = to_limbs(mont.mul(from_limbs(a), from_limbs(b)));
+    const limbs tr = ref_mod(ref_shl(t, 32 * n.size()), n);
+    expect(ref_cmp(t, n) < 0 && tr == ref_mod(ref_mul(a, b), n), "montgomery", a, b, n);
+
+    const BigUint inv = bn.mod_mul_inv(from_limbs(a));
+    if (inv > 0) {
+      expect(ref_mod(ref_mul(to_limbs(inv), a), n) == limbs{1}, "mod_mul_inv", a, n);
+    } else {
+      // gcd(a, n) > 1 for n > 1
+      limbs x = n, y = a;
+      while (y != limbs{0}) {
+        limbs r = ref_mod(x, y);
+        x = y;
+        y = r;
+      }
+      expect(x != limbs{1}, "mod_mul_inv not invertible", a, n);
+    }
+    const uint32_t k = rng.next() | 1;
+    const BigUint inv32 = bn.mod_mul_inv(k);
+    if (inv32 > 0) {
+      expect(ref_mod(ref_mul(to_limbs(inv32), limbs{k}), n) == limbs{1}, "mod_mul_inv uint32", limbs{k}, n);
+    }
+
+    // short exponents keep the reference fast
+    limbs e = random_limbs(rng, 2);
+    const limbs p = ref_pow(a, e, n);
+    expect(to_limbs(mont.pow(from_limbs(a), from_limbs(e))) == p, "Montgomery::pow", a, e, n);
+    expect(to_limbs(bn.mod_pow(from_limbs(a), from_limbs(e))) == p, "mod_pow", a, e, n);
+    for (int w = 1; w <= 6; w += 5) {
+      Montgomery::exponent x = Montgomery::recode(from_limbs(e), w);
+      expect(to_limbs(mont.pow(from_limbs(a), x)) == p, "Montgomery::pow window", a, e, n);
+    }
+  }
+
+  void fixed_base() {
+    const limbs n = random_modulus(8);
+    const Montgomery mont(from_limbs(n));
+    const BigUint g = from_limbs(random_limbs(rng, 8));
+    const int bits = 1 + rng.uniform(128);
+    FixedBase fb(mont, g, bits, 1 + rng.uniform(5), 1 + rng.uniform(3));
+    for (int i = 0; i < 8; ++i) {
+      // exactly eb bits, from rng so the printed seed replays them
+      const int eb = 1 + rng.uniform(bits);
+      limbs x((eb + 31) / 32);
+      rng.fill(x.data(), x.size());
+      x.back() &= UINT32_MAX >> (31 - (eb - 1) % 32);
+      x.back() |= 1u << ((eb - 1) % 32);
+      const BigUint e = from_limbs(x);
+      expect(fb.pow(e) == mont.pow(g, e), "FixedBase::pow", to_limbs(g), to_limbs(e), n);
+    }
+  }
+
+  void run(uint64_t rounds) {
+    for (uint64_t i = 0; i < rounds; ++i) {
+      arithmetic();
+      if (i % 8 == 0) {
+        modular();
+      }
+      if (i % 128 == 0) {
+        fixed_base();
+      }
+    }
+  }
+
+  Drbg rng;
+  uint32_t seed;
+  uint64_t cases;
+  uint64_t failures;
+};
+
+int main(int argc, char *argv[]) {
+  const uint64_t rounds = argc > 1 ? strtoull(argv[1], nullptr, 10) : 5000;
+  const uint32_t seed = argc > 2 ? strtoul(argv[2], nullptr, 10) : Drbg::local().next();
+  int threads = argc > 3 ? atoi(argv[3]) : thread::hardware_concurrency();
+  if (threads <= 0) {
+    threads = 1;
+  }
+
+  vector<thread> workers;
+  atomic<uint64_t> cases{0}, failures{0};
+  auto start = chrono::steady_clock::now();
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t]() {
+      tester tst(seed + 1000 * t);
+      tst.run(rounds);
+      cases += tst.cases;
+      failures += tst.failures;
+    });
+  }
+  for (auto& w : workers) {
+    w.join();
+  }
+  const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  cout<<cases<<" cases on "<<threads<<" threads, seed "<<seed<<", "
+      <<(uint64_t)(cases / seconds)<<" cases/s, "<<failures<<" failed"<<endl;
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,103 @@
+#include <cstring>
+#include <iostream>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "biguint.h"
+#include "check.h"
+#include "drbg.h"
+
+using namespace std;
+using namespace simple_rsa;
+
+// RFC 7539, section 2.3.2
+void test_chacha20_block() {
+  const uint32_t in[16] = {
+    0x61707865, 0x3320646e, 0x79622d32, 0x6b206574,
+    0x03020100, 0x07060504, 0x0b0a0908, 0x0f0e0d0c,
+    0x13121110, 0x17161514, 0x1b1a1918, 0x1f1e1d1c,
+    0x00000001, 0x09000000, 0x4a000000, 0x00000000};
+  const uint32_t expected[16] = {
+    0xe4e7f110, 0x15593bd1, 0x1fdd0f50, 0xc47120a3,
+    0xc7f4d1c7, 0x0368c033, 0x9aaa2204, 0x4e6cd4c3,
+    0x466482d2, 0x09aa9f07, 0x05d7c214, 0xa2028bd9,
+    0xd19c12b5, 0xb94e16de, 0xe883d0cb, 0x4e3c50a2};
+  uint32_t out[16];
+  chacha20_block(in, out);
+  for (int i = 0; i < 16; ++i) {
+    check(out[i] == expected[i], "chacha20_block");
+  }
+}
+
+void test_seeded() {
+  const uint32_t seed[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+  Drbg a(seed), b(seed);
+  uint32_t x[1000], y[1000];
+  a.fill(x, 1000);
+  for (int i = 0; i < 1000; ++i) {
+    y[i] = b.next();
+  }
+  bool same = true;
+  for (int i = 0; i < 1000; ++i) {
+    same = same && x[i] == y[i];
+  }
+  check(same, "seeded Drbg is deterministic");
+  check(Drbg::local().next() != Drbg::local().next(), "Drbg::local");
+}
+
+// a forked child reseeds instead of repeating the parent's buffer
+void test_fork() {
+  Drbg& rng = Drbg::local();
+  rng.next();
+  int fds[2];
+  if (pipe(fds) != 0) {
+    check(false, "pipe");
+    return;
+  }
+  pid_t pid = fork();
+  if (pid == 0) {
+    uint32_t x[4];
+    rng.fill(x, 4);
+    ssize_t w = write(fds[1], x, sizeof(x));
+    _exit(w == sizeof(x) ? 0 : 1);
+  }
+  uint32_t parent[4], child[4];
+  rng.fill(parent, 4);
+  ssize_t r = read(fds[0], child, sizeof(child));
+  int status = 0;
+  waitpid(pid, &status, 0);
+  close(fds[0]);
+  close(fds[1]);
+  check(r == sizeof(child) && status == 0, "forked child output");
+  check(std::memcmp(parent, child, sizeof(child)) != 0, "Drbg reseeds after fork");
+}
+
+void test_random_bits() {
+  BigUint a, b;
+  for (int bits = 1; bits <= 1024; ++bits) {
+    a.random_bits(bits);
+    check(a.bits() == bits, "random_bits");
+  }
+  a.random_bits(1024);
+  b.random_bits(1024);
+  check(a != b, "random_bits repeats");
+}
+
+void test_miller_rabin() {
+  const uint32_t primes[] = {2, 3, 5, 7, 65537, 2147483647u, 4294967291u};
+  const uint32_t composites[] = {1, 4, 9, 561, 1105, 8911, 3215031751u, 4294967295u};
+  for (auto p : primes) {
+    check(miller_rabin_test(p), "miller_rabin_test prime");
+  }
+  for (auto c : composites) {
+    check(!miller_rabin_test(c), "miller_rabin_test composite");
+  }
+}
+
+int main() {
+  test_chacha20_block();
+  test_seeded();
+  test_fork();
+  test_random_bits();
+  test_miller_rabin();
+  return report();
+}
@@ -0,0 +1,34 @@
+#include <iostream>
+#include "check.h"
+#include "fixed_base.h"
+
+using namespace std;
+using namespace simple_rsa;
+
+void test(int bits, int h, int v) {
+  BigUint n, g, e;
+  n.random_bits(bits);
+  n.set_bit(0);
+  g.random_bits(bits - 1);
+  Montgomery mont(n);
+  FixedBase fb(mont, g, bits, h, v);
+  check(fb.table_size() == (size_t)v * ((1u << h) - 1), "table_size");
+  for (int i = 0; i < 10; ++i) {
+    e.random_bits(i == 0 ? 1 : bits - i % 7);
+    check(fb.pow(e) == mont.pow(g, e), "FixedBase::pow");
+  }
+  check(fb.pow(0) == 1, "g^0");
+  e.random_bits(bits + 5);
+  check(fb.pow(e) == mont.pow(g, e), "FixedBase::pow beyond max_bits");
+}
+
+int main() {
+  for (int bits : {32, 61, 256, 333}) {
+    for (int h : {1, 3, 4, 6}) {
+      for (int v : {1, 2, 3}) {
+        test(bits, h, v);
+      }
+    }
+  }
+  return report();
+}
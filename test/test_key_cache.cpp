@@ -0,0 +1,93 @@
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <thread>
+#include "check.h"
+#include "key_cache.h"
+
+using namespace std;
+using namespace simple_rsa;
+
+map<string, rsa_key> keys;
+atomic<int> loads{0};
+
+KeyCache::context_ptr load(const string& id) {
+  ++loads;
+  auto it = keys.find(id);
+  if (it == keys.end()) {
+    return nullptr;
+  }
+  return make_shared<rsa_context>(it->second);
+}
+
+void test_context() {
+  for (auto& k : keys) {
+    rsa_context ctx(k.second);
+    BigUint m;
+    m.random_bits(k.second.bits() - 1);
+    check(ctx.private_op(ctx.public_op(m)) == m, "private_op(public_op(m))");
+    check(ctx.private_op(m) == k.second.n.mod_pow(m, k.second.d), "private_op by CRT");
+    for (int i = 0; i < rsa_context::BLINDING_USES + 2; ++i) {
+      check(ctx.blinded_private_op(m) == ctx.private_op(m), "blinded_private_op");
+    }
+  }
+}
+
+void test_lru() {
+  // the sizes of d, dp, ... differ by a uint32 from key to key
+  size_t one = 0;
+  for (auto& k : keys) {
+    one = max(one, rsa_context(k.second).memory() + 1);
+  }
+  KeyCache cache(one * 2, load, 1);
+  loads = 0;
+  check(cache.get("a") && cache.get("b"), "get");
+  check(cache.get("a") != nullptr, "hit");
+  // "b" is the least recently used
+  check(cache.get("c") != nullptr, "get c");
+  check(cache.find("b") == nullptr, "b evicted");
+  check(cache.find("a") != nullptr, "a kept");
+  check(cache.get("x") == nullptr, "unknown id");
+  KeyCache::stats st = cache.statistics();
+  check(st.hits == 1 && st.misses == 4 && st.evictions == 1, "statistics");
+  check(st.entries == 2 && st.memory <= one * 2, "memory budget");
+  check(loads == 4, "loads");
+  cache.erase("a");
+  check(cache.find("a") == nullptr && cache.statistics().entries == 1, "erase");
+}
+
+void test_threads() {
+  KeyCache cache(1 << 20, load, 4);
+  const string ids[] = {"a", "b", "c"};
+  vector<thread> threads;
+  atomic<int> wrong{0};
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < 200; ++i) {
+        const string& id = ids[(t + i) % 3];
+        auto ctx = cache.get(id);
+        if (!ctx || ctx->key().n != keys[id].n) {
+          ++wrong;
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  check(wrong == 0, "concurrent get");
+  KeyCache::stats st = cache.statistics();
+  check(st.hits + st.misses == 1600 && st.entries == 3, "concurrent statistics");
+}
+
+int main() {
+  for (const char *id : {"a", "b", "c"}) {
+    rsa r;
+    r.keygen(256);
+    keys[id] = r.key();
+  }
+  test_context();
+  test_lru();
+  test_threads();
+  return report();
+}
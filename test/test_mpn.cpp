@@ -0,0 +1,151 @@
+#include <iostream>
+#include <vector>
+#include "biguint.h"
+#include "check.h"
+#include "drbg.h"
+#include "montgomery.h"
+#include "mpn.h"
+
+using namespace std;
+using namespace simple_rsa;
+
+typedef vector<uint32_t> limbs;
+
+// multiplies from a static initializer, which may run before mpn's
+// own, the word kernels must already be usable
+BigUint static_square() {
+  const uint32_t x[4] = {UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX};
+  const BigUint b(x, 4);
+  return b * b;
+}
+
+const BigUint STATIC_SQUARE = static_square();
+
+const uint32_t seed[8] = {7, 6, 5, 4, 3, 2, 1, 0};
+Drbg rng(seed);
+
+// random, all ones or sparse
+limbs random_limbs(size_t n) {
+  limbs a(n);
+  switch (rng.uniform(4)) {
+  case 0:
+    for (auto& x : a) {
+      x = UINT32_MAX;
+    }
+    break;
+  case 1:
+    a[rng.uniform(n)] = rng.next();
+    break;
+  default:
+    rng.fill(a.data(), n);
+  }
+  return a;
+}
+
+// one uint32 at a time, independent of the word kernels
+uint32_t ref_addmul_1(uint32_t *rp, const uint32_t *ap, size_t n, uint32_t b) {
+  uint64_t c = 0;
+  for (size_t i = 0; i < n; ++i) {
+    c += (uint64_t)ap[i] * b + rp[i];
+    rp[i] = (uint32_t)c;
+    c >>= 32;
+  }
+  return c;
+}
+
+limbs ref_mul(const limbs& a, const limbs& b) {
+  limbs r(a.size() + b.size());
+  for (size_t j = 0; j < b.size(); ++j) {
+    r[j + a.size()] = ref_addmul_1(r.data() + j, a.data(), a.size(), b[j]);
+  }
+  return r;
+}
+
+void test_kernels(mpn::kernel_set k, const char *name) {
+  if (!mpn::use_kernels(k)) {
+    cout<<name<<" kernels not supported, skipped"<<endl;
+    return;
+  }
+  for (int i = 0; i < 2000; ++i) {
+    const size_t n = 1 + rng.uniform(40), m = 1 + rng.uniform(40);
+    const limbs a = random_limbs(n), b = random_limbs(m), r0 = random_limbs(n);
+    const uint32_t k32 = rng.uniform(3) == 0 ? UINT32_MAX : rng.next();
+
+    limbs r = r0, e = r0;
+    uint32_t c = mpn::addmul_1(r.data(), a.data(), n, k32);
+    check(c == ref_addmul_1(e.data(), a.data(), n, k32) && r == e, name);
+
+    limbs z(n, 0);
+    e = z;
+    c = mpn::mul_1(r.data(), a.data(), n, k32);
+    check(c == ref_addmul_1(e.data(), a.data(), n, k32) && r == e, name);
+    // in place
+    r = a;
+    c = mpn::addmul_1(r.data(), r.data(), n, k32);
+    e = a;
+    check(c == ref_addmul_1(e.data(), a.data(), n, k32) && r == e, name);
+
+    limbs p(n + m);
+    mpn::mul(p.data(), a.data(), n, b.data(), m);
+    check(p == ref_mul(a, b), name);
+  }
+}
+
+void test_mont_mul(mpn::kernel_set k, const char *name) {
+  if (!mpn::use_kernels(k)) {
+    return;
+  }
+  for (int i = 0; i < 500; ++i) {
+    // even and odd sizes take different paths
+    BigUint n;
+    n.random_bits(32 + rng.uniform(1024));
+    n.set_bit(0);
+    const Montgomery mont(n);
+    const size_t size = mont.size();
+    BigUint x, y;
+    x.random_bits(n.bits() + 8);
+    y.random_bits(n.bits() + 8);
+    x %= n;
+    y %= n;
+    limbs a(size), b(size), r(size), t(2 * size + 2);
+    copy(x.data(), x.data() + x.size(), a.begin());
+    copy(y.data(), y.data() + y.size(), b.begin());
+    mpn::mont_mul(r.data(), a.data(), b.data(), n.data(), size, mont.m(), t.data());
+    // r * R == x * y mod(n)
+    BigUint rr(r.data(), size);
+    check(rr < n, name);
+    rr.left_shift(32 * size);
+    const limbs xy = ref_mul(limbs(x.data(), x.data() + x.size()), limbs(y.data(), y.data() + y.size()));
+    check(rr % n == BigUint(xy.data(), xy.size()) % n, name);
+  }
+}
+
+void test_mod_1() {
+  for (int i = 0; i < 2000; ++i) {
+    const limbs a = random_limbs(1 + rng.uniform(40));
+    const uint32_t d = i == 0 ? 0x80000000 : i == 1 ? UINT32_MAX : rng.next() | 0x80000000;
+    const uint32_t v = (uint32_t)(UINT64_MAX / d - ((uint64_t)1 << 32));
+    uint64_t r = 0;
+    for (size_t j = a.size(); j-- > 0;) {
+      r = ((r << 32) | a[j]) % d;
+    }
+    check(mpn::mod_1(a.data(), a.size(), d, v) == r, "mod_1");
+  }
+}
+
+int main() {
+  // (2^128 - 1)^2 = 2^256 - 2^129 + 1
+  BigUint square(1);
+  square.left_shift(256);
+  square -= BigUint(1).left_shift(129);
+  square += 1;
+  check(STATIC_SQUARE == square, "multiplication in a static initializer");
+  const mpn::kernel_set best = mpn::kernels();
+  test_kernels(mpn::KERNELS_GENERIC, "generic");
+  test_kernels(mpn::KERNELS_ADX, "adx");
+  test_mont_mul(mpn::KERNELS_GENERIC, "generic mont_mul");
+  test_mont_mul(mpn::KERNELS_ADX, "adx mont_mul");
+  mpn::use_kernels(best);
+  test_mod_1();
+  return report();
+}
@@ -0,0 +1,148 @@
+#include <iostream>
+#include <vector>
+#include "check.h"
+#include "drbg.h"
+#include "prime.h"
+
+using namespace std;
+using namespace simple_rsa;
+
+BigUint from_uint64(uint64_t x) {
+  const uint32_t limbs[2] = {(uint32_t)x, (uint32_t)(x >> 32)};
+  return BigUint(limbs, 2);
+}
+
+// 2^n - 1
+BigUint mersenne(int n) {
+  BigUint b(1);
+  b.left_shift(n);
+  return b -= 1;
+}
+
+bool consistent(const prime_stats& s) {
+  return s.candidates == s.sieve + s.fermat + s.miller_rabin + s.primes;
+}
+
+void test_tables() {
+  check(PRIME_NUMBERS[0] == 3 && PRIME_NUMBERS[1] == 5 && PRIME_NUMBERS[2] == 7, "first primes");
+  // every odd number up to the last one is in the table or has a factor in it
+  int i = 0;
+  for (uint32_t x = 3; x <= PRIME_NUMBERS[PRIME_NUMBERS_SIZE - 1]; x += 2) {
+    bool prime = true;
+    for (uint32_t d = 3; d * d <= x && prime; d += 2) {
+      prime = x % d != 0;
+    }
+    if (prime) {
+      check(i < PRIME_NUMBERS_SIZE && PRIME_NUMBERS[i++] == x, "prime table");
+    }
+  }
+  check(i == PRIME_NUMBERS_SIZE, "prime table size");
+
+  int next = 0;
+  for (int g = 0; g < PRIME_GROUPS_SIZE; ++g) {
+    const prime_group& group = PRIME_GROUPS[g];
+    check(group.first == next && group.count > 0 && (group.d & 0x80000000) != 0, "prime group");
+    for (int j = group.first; j < group.first + group.count; ++j) {
+      check(group.d % PRIME_NUMBERS[j] == 0, "prime group product");
+    }
+    next = group.first + group.count;
+  }
+  check(next == PRIME_NUMBERS_SIZE, "prime groups cover the table");
+}
+
+void test_remainders() {
+  Drbg& rng = Drbg::local();
+  for (int i = 0; i < PRIME_NUMBERS_SIZE; ++i) {
+    const uint32_t p = PRIME_NUMBERS[i];
+    for (uint32_t a : {0u, 1u, p - 1, p, p + 1, UINT32_MAX, rng.next(), rng.next()}) {
+      if (prime_mod(a, i) != a % p) {
+        check(false, "prime_mod");
+      }
+    }
+  }
+  vector<uint32_t> r(PRIME_NUMBERS_SIZE);
+  for (int bits : {1, 31, 33, 512, 1024, 2048}) {
+    BigUint b;
+    b.random_bits(bits);
+    prime_remainders(b, r.data());
+    for (int i = 0; i < PRIME_NUMBERS_SIZE; ++i) {
+      if (r[i] != b % PRIME_NUMBERS[i]) {
+        check(false, "prime_remainders");
+        break;
+      }
+    }
+  }
+}
+
+void test_stages() {
+  const BigUint b[] = {
+    2, 3, 65537, 1, 9, 561,
+    // sieve
+    BigUint(4294967291u) * 3, mersenne(128),
+    // fermat, two primes above the sieve
+    BigUint(4294967291u) * BigUint(4294967279u),
+    // 149491 * 747451 * 34233211 is a strong pseudoprime to base 2
+    from_uint64(3825123056546413051ull),
+    mersenne(89), mersenne(127), 4294967291u,
+  };
+  const bool expected[] = {true, true, true, false, false, false,
+                           false, false, false, false, true, true, true};
+  const size_t n = sizeof(b) / sizeof(b[0]);
+  bool prime[n];
+  prime_stats stats;
+  prime_test(b, n, prime, &stats);
+  for (size_t i = 0; i < n; ++i) {
+    check(prime[i] == expected[i], "prime_test");
+  }
+  check(stats.candidates == n && consistent(stats), "prime_test stats add up");
+  check(stats.fermat == 1, "fermat rejects a product of two large primes");
+  check(stats.miller_rabin == 1, "miller-rabin rejects a base 2 pseudoprime");
+  check(stats.primes == 6, "prime_test primes");
+}
+
+void test_random_batch() {
+  const size_t n = 2000;
+  BigUint b[n];
+  for (auto& x : b) {
+    x.random_bits(128);
+  }
+  bool prime[n];
+  prime_stats stats;
+  prime_test(b, n, prime, &stats);
+  size_t primes = 0;
+  for (size_t i = 0; i < n; ++i) {
+    check(prime[i] == miller_rabin_test(b[i]), "prime_test agrees with miller_rabin_test");
+    primes += prime[i];
+  }
+  check(consistent(stats) && stats.primes == primes, "random batch stats");
+  check(primes > 0 && stats.sieve > n / 2, "random batch stages");
+}
+
+void test_next_prime() {
+  prime_stats stats;
+  for (int i = 0; i < 20; ++i) {
+    BigUint b;
+    b.random_bits(160);
+    const BigUint p = next_prime(b, &stats);
+    check(p >= b && miller_rabin_test(p), "next_prime is prime");
+    for (BigUint c = b.is_even() ? b + 1 : b; c < p; c += 2) {
+      if (miller_rabin_test(c)) {
+        check(false, "next_prime skipped a prime");
+        break;
+      }
+    }
+  }
+  check(consistent(stats) && stats.primes == 20, "next_prime stats");
+  check(stats.sieve_rate() > 0.5 && stats.sieve_rate() < 1, "next_prime sieve rate");
+  // 2^89 - 1 is prime, the next one after 2^89 - 2
+  check(next_prime(mersenne(89) - 1) == mersenne(89), "next_prime of an even number");
+}
+
+int main() {
+  test_tables();
+  test_remainders();
+  test_stages();
+  test_random_batch();
+  test_next_prime();
+  return report();
+}
@@ -0,0 +1,147 @@
+#include <iostream>
+#include <thread>
+#include "check.h"
+#include "rsa_service.h"
+
+using namespace std;
+using namespace simple_rsa;
+
+void test_queue() {
+  MpmcQueue<int> q(5);
+  check(q.capacity() == 8, "capacity");
+  int x = 0;
+  check(!q.try_pop(x), "empty");
+  for (int i = 0; i < 8; ++i) {
+    check(q.try_push(int(i)), "push");
+  }
+  check(!q.try_push(8) && q.size() == 8, "full");
+  for (int i = 0; i < 8; ++i) {
+    check(q.try_pop(x) && x == i, "fifo");
+  }
+
+  // every value comes out exactly once
+  MpmcQueue<int> mq(64);
+  const int per_thread = 20000;
+  atomic<long long> sum{0};
+  atomic<int> popped{0};
+  vector<thread> threads;
+  for (int t = 0; t < 2; ++t) {
+    threads.emplace_back([&, t]() {
+      for (int i = 1; i <= per_thread; ++i) {
+        while (!mq.try_push(i * 2 + t)) {
+          this_thread::yield();
+        }
+      }
+    });
+    threads.emplace_back([&]() {
+      int v;
+      while (popped < 2 * per_thread) {
+        if (mq.try_pop(v)) {
+          sum += v;
+          ++popped;
+        } else {
+          this_thread::yield();
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  const long long n = per_thread;
+  check(sum == 2 * n * (n + 1) + n, "mpmc sum");
+}
+
+void test_service(const vector<shared_ptr<const rsa_context>>& keys) {
+  RsaService service(2);
+  vector<future<BigUint>> results;
+  vector<BigUint> expected;
+  for (int i = 0; i < 40; ++i) {
+    const auto& k = keys[i % keys.size()];
+    BigUint m;
+    m.random_bits(k->key().bits() - 1);
+    switch (i % 4) {
+    case 0:
+      results.push_back(service.submit(RSA_ENCRYPT, k, m));
+      expected.push_back(k->public_op(m));
+      break;
+    case 1:
+      results.push_back(service.submit(RSA_DECRYPT, k, m));
+      expected.push_back(k->private_op(m));
+      break;
+    case 2:
+      results.push_back(service.submit(RSA_SIGN, k, m));
+      expected.push_back(k->private_op(m));
+      break;
+    default:
+      results.push_back(service.submit(RSA_VERIFY, k, m));
+      expected.push_back(k->public_op(m));
+    }
+  }
+  for (size_t i = 0; i < results.size(); ++i) {
+    check(results[i].get() == expected[i], "future result");
+  }
+
+  atomic<int> done{0};
+  const BigUint m{12345};
+  const BigUint c = keys[0]->public_op(m);
+  for (int i = 0; i < 10; ++i) {
+    check(service.submit(RSA_DECRYPT, keys[0], c, [&](const BigUint& r, exception_ptr e) {
+      check(!e && r == m, "callback result");
+      ++done;
+    }), "callback submit");
+  }
+  while (done < 10) {
+    this_thread::yield();
+  }
+
+  rsa_key pub;
+  pub.n = keys[0]->key().n;
+  pub.e = keys[0]->key().e;
+  auto public_key = make_shared<rsa_context>(pub);
+  bool thrown = false;
+  try {
+    service.submit(RSA_SIGN, public_key, m).get();
+  } catch (const invalid_argument&) {
+    thrown = true;
+  }
+  check(thrown, "private op on a public key");
+  check(service.submit(RSA_VERIFY, public_key, c).get() == keys[0]->public_op(c), "public key");
+
+  RsaService::stats st = service.statistics();
+  check(st.submitted == 51 && st.completed == 51 && st.rejected == 0, "statistics");
+  check(st.p50 > 0 && st.p50 <= st.p99 && st.p99 <= st.p999, "percentiles");
+}
+
+void test_backlog(const shared_ptr<const rsa_context>& key) {
+  // one worker and a tiny queue, submitting faster than it can run
+  atomic<int> done{0};
+  int accepted = 0;
+  {
+    RsaService service(1, 4, 4);
+    for (int i = 0; i < 64; ++i) {
+      accepted += service.submit(RSA_SIGN, key, BigUint(i + 2), [&](const BigUint&, exception_ptr e) {
+        check(!e, "backlog result");
+        ++done;
+      });
+    }
+    RsaService::stats st = service.statistics();
+    check(st.rejected > 0 && st.rejected + st.submitted == 64, "rejected when full");
+    check(st.max_queue_depth <= 4, "queue depth");
+  }
+  // the destructor finishes what was queued
+  check(done == accepted, "drained");
+}
+
+int main() {
+  test_queue();
+  vector<shared_ptr<const rsa_context>> keys;
+  for (int i = 0; i < 3; ++i) {
+    rsa r;
+    r.keygen(512);
+    keys.push_back(r.context());
+  }
+  test_service(keys);
+  test_backlog(keys[0]);
+  return report();
+}
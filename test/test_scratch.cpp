@@ -0,0 +1,119 @@
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include "biguint.h"
+#include "check.h"
+#include "montgomery.h"
+#include "scratch.h"
+
+using namespace std;
+using namespace simple_rsa;
+
+// global heap allocations, the test is single threaded
+size_t allocations = 0;
+
+void* operator new(size_t n) {
+  ++allocations;
+  void *p = malloc(n == 0 ? 1 : n);
+  if (p == nullptr) {
+    throw bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void *p) noexcept {
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+  free(p);
+}
+
+void test_scopes() {
+  Scratch s;
+  check(s.used() == 0 && s.capacity() == 0, "empty");
+  {
+    Scratch::Scope a(s);
+    uint32_t *p = a.alloc(3);
+    uint32_t *q = a.alloc(5);
+    check((uintptr_t)p % 16 == 0 && (uintptr_t)q % 16 == 0, "aligned");
+    check(q - p == 4, "bump");
+    check(s.used() == 12, "used");
+    {
+      Scratch::Scope b(s);
+      b.alloc(100);
+      check(s.used() == 112, "nested used");
+    }
+    check(s.used() == 12, "nested release");
+    // larger than the first chunk
+    uint32_t *r = a.alloc(10000);
+    r[9999] = 1;
+    check(s.used() == 10012, "large");
+  }
+  check(s.used() == 0, "release");
+  check(s.high_water() == 10012, "high water");
+  const size_t capacity = s.capacity();
+  check(capacity >= 10012, "capacity");
+  {
+    Scratch::Scope a(s);
+    a.alloc(10000);
+  }
+  check(s.capacity() == capacity, "chunks reused");
+  s.reset_high_water();
+  check(s.high_water() == 0, "reset high water");
+}
+
+void test_no_heap() {
+  BigUint n, x, e;
+  n.random_bits(1024);
+  n.set_bit(0);
+  x.random_bits(2048);
+  e.random_bits(1024);
+  const Montgomery mont(n);
+  const Montgomery::exponent ex = Montgomery::recode(e);
+  const BigUint xr = x % n;
+  const BigUint expected = mont.pow(x, ex);
+  Scratch& scratch = Scratch::local();
+  const size_t size = mont.size();
+  uint32_t *buffer = new uint32_t[size];
+
+  // the first run sizes the arena, later ones must not allocate
+  BigUint r;
+  for (int i = 0; i < 3; ++i) {
+    r = x;
+    size_t before = allocations;
+    r %= n;
+    check(i == 0 || allocations == before, "division on the heap");
+
+    before = allocations;
+    mont.to_mont(buffer, xr);
+    mont.pow(buffer, buffer, ex);
+    mont.mul(buffer, buffer, buffer);
+    check(i == 0 || allocations == before, "montgomery on the heap");
+  }
+  check(r == x % n, "division");
+  check(mont.from_mont(buffer) == mont.pow(expected * expected, 1), "raw montgomery");
+  check(scratch.used() == 0, "scratch released");
+  check(scratch.high_water() > 0, "scratch used");
+  delete[] buffer;
+}
+
+void test_miller_rabin() {
+  // 2^127 - 1
+  BigUint p{1};
+  p.left_shift(127);
+  p -= 1;
+  check(miller_rabin_test(p), "prime");
+  check(!miller_rabin_test(p * 561), "composite");
+  check(!miller_rabin_test(BigUint(561)), "carmichael");
+  check(Scratch::local().used() == 0, "scratch released");
+}
+
+int main() {
+  test_scopes();
+  test_no_heap();
+  test_miller_rabin();
+  cout<<"high water: "<<Scratch::local().high_water() * 4<<" bytes"<<endl;
+  return report();
+}